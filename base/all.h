@@ -9,6 +9,7 @@
 #include "istream.h"
 #include "memory.h"
 #include "ostream.h"
+#include "parallel.h"
 #include "random.h"
 #include "traits.h"
 #include "util.h"
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using std::vector, std::max, std::min;
+using std::atomic, std::thread;
+
+inline int default_threads() {
+	return max(1u, thread::hardware_concurrency());
+}
+
+// Calls f(thread_id) for every thread_id in [0, threads), the calling thread runs thread_id = 0.
+template <typename Func>
+void run_threads(int threads, const Func& f) {
+	vector<thread> pool;
+	for (int i = 1; i < threads; ++i) {
+		pool.emplace_back([&f, i]() { f(i); });
+	}
+	f(0);
+	for (auto& t : pool) {
+		t.join();
+	}
+}
+
+// Calls f(i, thread_id) for every i in [l, r); threads grab chunks of `chunk` consecutive indices
+// from a shared cursor, so uneven iterations are balanced automatically.
+template <typename Func>
+void parallel_for(long long l, long long r, const Func& f, int threads = default_threads(), long long chunk = 1) {
+	if (threads <= 1 || r - l <= chunk) {
+		for (long long i = l; i < r; ++i) {
+			f(i, 0);
+		}
+		return;
+	}
+	atomic<long long> cursor(l);
+	run_threads(threads, [&](int tid) {
+		while (true) {
+			const long long from = cursor.fetch_add(chunk);
+			if (from >= r) {
+				break;
+			}
+			for (long long i = from; i < min(r, from + chunk); ++i) {
+				f(i, tid);
+			}
+		}
+	});
+}
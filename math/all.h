@@ -15,6 +15,10 @@
 #include "prime.h"
 #include "prime_count.h"
 #include "sieve.h"
+#include "spf_table.h"
+#include "segmented_sieve.h"
+#include "quotient_array.h"
+#include "dirichlet_prefix.h"
 #include "berlekamp.h"
 #include "continued_fraction.h"
 #include "util.h"
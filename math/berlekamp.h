@@ -1,8 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <utility>
 #include <vector>
 
-using std::vector;
+#include "fft_interface.h"
+
+using std::vector, std::array, std::pair;
+using std::max, std::min, std::swap;
 
 template <typename T>
 vector<T> find_linear_recurrence(const vector<T>& a) {
@@ -14,42 +21,235 @@ vector<T> find_linear_recurrence(const vector<T>& a) {
 		}
 		return res;
 	};
+	// -1, p_0, p_1, ... for p before its last growth, divided by its discrepancy at last_idx
 	vector<T> last_incorrect;
 	int last_idx = -1;
 	for (int i = 0; i < (int)a.size(); ++i) {
-		auto cur = get(i);
+		const auto cur = get(i);
 		if (cur == a[i]) {
 			continue;
 		}
-		auto new_p = p;
-		bool need_to_upd = true;
-		if (new_p.empty()) {
-			new_p.assign(i + 1, 0);
-		} else {
-			const int sz = (i - last_idx - 1) + (int)last_incorrect.size();
-			if (sz > (int)new_p.size()) {
-				new_p.resize(sz);
-			} else {
-				need_to_upd = false;
-			}
+		const T delta = a[i] - cur;
+		const T inv = 1 / (cur - a[i]);
+		if (p.empty()) {
+			p.assign(i + 1, 0);
+			last_incorrect = {-inv};
+			last_idx = i;
+			continue;
+		}
+		const int shift = i - last_idx - 1;
+		const int sz = shift + (int)last_incorrect.size();
+		if (sz <= (int)p.size()) {
 			for (int j = 0; j < (int)last_incorrect.size(); ++j) {
-				new_p[i - last_idx - 1 + j] += last_incorrect[j] * (a[i] - cur);
+				p[shift + j] += last_incorrect[j] * delta;
 			}
+			continue;
 		}
-		if (need_to_upd) {
-			last_incorrect = p;
-			last_incorrect.insert(last_incorrect.begin(), -1);
-			auto inv = 1 / (cur - a[i]);
-			for (auto& x : last_incorrect) {
-				x *= inv;
+		// p grows and its old value becomes last_incorrect: going down, entry j + 1 of last_incorrect is not needed
+		// anymore when p_j is updated, so it is overwritten in place
+		const int old = p.size();
+		p.resize(sz);
+		last_incorrect.resize(max(sz - shift, old + 1));
+		for (int j = sz - 1; j >= 0; --j) {
+			const T t = p[j];
+			if (j >= shift) {
+				p[j] += last_incorrect[j - shift] * delta;
+			}
+			if (j < old) {
+				last_incorrect[j + 1] = t * inv;
 			}
-			last_idx = i;
 		}
-		p.swap(new_p);
+		last_incorrect[0] = -inv;
+		last_incorrect.resize(old + 1);
+		last_idx = i;
 	}
 	return p;
 }
 
+// The same in O(n log^2 n), the length is the same, but the recurrence itself is not unique for 2L > n.
+// Let s = sum a_i x^{n - 1 - i} and r_k = u_k x^n + v_k s be the remainders of the Euclid algorithm on x^n and s. A recurrence of length L is
+// a polynomial V of degree L with deg(V s mod x^n) < L, and the minimal one is v_k for the first k with deg r_k < deg v_k.
+// The half-GCD finds the pair of remainders with deg r_{k - 1} >= n / 2 > deg r_k, after that at most one step is left.
+template <typename T, typename Inner, int N>
+class HalfGcdRecurrence {
+public:
+	using Poly = vector<T>;
+
+	explicit HalfGcdRecurrence(IFFT<T, Inner, N>& _fft): fft(_fft) {}
+
+	vector<T> find(const vector<T>& a) {
+		const int n = a.size();
+		Poly s{a.rbegin(), a.rend()};
+		trim(s);
+		if (s.empty()) {
+			return {};
+		}
+		Poly xn(n + 1);
+		xn[n] = 1;
+		const auto m = hgcd(xn, s);
+		auto [r0, r1] = apply(m, xn, s);
+		Poly v0 = m[0][1], v1 = m[1][1];
+		if (deg(r1) >= deg(v1)) {
+			const auto q = divmod(r0, r1).first;
+			v0 = sub(v0, mul(q, v1));
+			swap(v0, v1);
+		}
+		const int l = deg(v1);
+		const T inv = -1 / v1[l];
+		vector<T> res(l);
+		for (int j = 1; j <= l; ++j) {
+			res[j - 1] = v1[l - j] * inv;
+		}
+		return res;
+	}
+
+private:
+	using Matrix = array<array<Poly, 2>, 2>;
+
+	IFFT<T, Inner, N>& fft;
+
+	// below this the products and the divisions are naive
+	static constexpr int naive = 64;
+
+	static int deg(const Poly& p) {
+		return (int)p.size() - 1;
+	}
+
+	static void trim(Poly& p) {
+		while (!p.empty() && p.back() == 0) {
+			p.pop_back();
+		}
+	}
+
+	static Poly add(Poly a, const Poly& b) {
+		a.resize(max(a.size(), b.size()));
+		for (int i = 0; i < (int)b.size(); ++i) {
+			a[i] += b[i];
+		}
+		trim(a);
+		return a;
+	}
+
+	static Poly sub(Poly a, const Poly& b) {
+		a.resize(max(a.size(), b.size()));
+		for (int i = 0; i < (int)b.size(); ++i) {
+			a[i] -= b[i];
+		}
+		trim(a);
+		return a;
+	}
+
+	// p div x^k
+	static Poly high(const Poly& p, int k) {
+		return k < (int)p.size() ? Poly{p.begin() + k, p.end()} : Poly{};
+	}
+
+	Poly mul(const Poly& a, const Poly& b) {
+		if (a.empty() || b.empty()) {
+			return {};
+		}
+		Poly res;
+		if (min(a.size(), b.size()) < naive) {
+			res.assign(a.size() + b.size() - 1, T(0));
+			for (int i = 0; i < (int)a.size(); ++i) {
+				for (int j = 0; j < (int)b.size(); ++j) {
+					res[i + j] += a[i] * b[j];
+				}
+			}
+		} else {
+			res = fft.multiply(a, b);
+		}
+		trim(res);
+		return res;
+	}
+
+	pair<Poly, Poly> divmod(const Poly& a, const Poly& b) {
+		if (a.size() < b.size()) {
+			return {{}, a};
+		}
+		if ((int)(a.size() - b.size()) >= naive && (int)b.size() >= naive) {
+			auto [q, r] = fft.divmod(a, b);
+			trim(q);
+			trim(r);
+			return {q, r};
+		}
+		Poly q(a.size() - b.size() + 1), r = a;
+		const T inv = 1 / b.back();
+		for (int i = deg(q); i >= 0; --i) {
+			q[i] = r[i + deg(b)] * inv;
+			for (int j = 0; j < (int)b.size(); ++j) {
+				r[i + j] -= q[i] * b[j];
+			}
+		}
+		r.resize(b.size() - 1);
+		trim(r);
+		return {q, r};
+	}
+
+	pair<Poly, Poly> apply(const Matrix& m, const Poly& a, const Poly& b) {
+		return {add(mul(m[0][0], a), mul(m[0][1], b)), add(mul(m[1][0], a), mul(m[1][1], b))};
+	}
+
+	Matrix product(const Matrix& x, const Matrix& y) {
+		Matrix res;
+		for (int i = 0; i < 2; ++i) {
+			for (int j = 0; j < 2; ++j) {
+				res[i][j] = add(mul(x[i][0], y[0][j]), mul(x[i][1], y[1][j]));
+			}
+		}
+		return res;
+	}
+
+	// (a, b) -> (b, a - q b)
+	Matrix step(Matrix m, const Poly& q) {
+		for (int j = 0; j < 2; ++j) {
+			m[0][j] = sub(m[0][j], mul(q, m[1][j]));
+		}
+		swap(m[0], m[1]);
+		return m;
+	}
+
+	// M with M (a, b) = (c, d) for consecutive remainders deg c >= (deg a + 1) / 2 > deg d, deg a > deg b
+	Matrix hgcd(const Poly& a, const Poly& b) {
+		const int k = (deg(a) + 1) / 2;
+		Matrix res = {{{Poly{1}, Poly{}}, {Poly{}, Poly{1}}}};
+		if (deg(b) < k) {
+			return res;
+		}
+		if (deg(a) < naive) {
+			Poly c = a, d = b;
+			while (deg(d) >= k) {
+				auto [q, r] = divmod(c, d);
+				res = step(res, q);
+				c = move(d);
+				d = move(r);
+			}
+			return res;
+		}
+		res = hgcd(high(a, k), high(b, k));
+		auto [c, d] = apply(res, a, b);
+		if (deg(d) < k) {
+			return res;
+		}
+		auto [q, r] = divmod(c, d);
+		res = step(res, q);
+		if (deg(r) < k) {
+			return res;
+		}
+		const int l = 2 * k - deg(d);
+		return product(hgcd(high(d, l), high(r, l)), res);
+	}
+};
+
+// the quadratic algorithm for the short sequences
+template <typename T, typename Inner, int N>
+vector<T> find_linear_recurrence(const vector<T>& a, IFFT<T, Inner, N>& fft) {
+	if ((int)a.size() < 3000) {
+		return find_linear_recurrence(a);
+	}
+	return HalfGcdRecurrence<T, Inner, N>(fft).find(a);
+}
+
 template <typename T>
 T get_nth_term_of_recurrence(const vector<T>& rec, const vector<T>& initial, long long n) {
 	if (n < (int)initial.size()) {
@@ -106,8 +306,100 @@ T get_nth_term_of_recurrence(const vector<T>& rec, const vector<T>& initial, lon
 	return answer;
 }
 
+// The same for every n of ns in O(d log d log n) with the multiplications of fft (Bostan-Mori): a_n = [x^n] P / Q
+// for Q = 1 - sum rec_i x^{i + 1} and P = A Q modulo x^d, and P / Q -> (P Q(-x))_{n mod 2} / (Q Q(-x))_even halves n.
+// Q does not depend on n, so its steps (and the images of Q(-x)) are shared between all the queries.
+template <typename T, typename Inner, int N>
+vector<T> get_nth_terms_of_recurrence(const vector<T>& rec, const vector<T>& initial, const vector<long long>& ns,
+		IFFT<T, Inner, N>& fft) {
+	const int d = rec.size();
+	assert((int)initial.size() >= d);
+	vector<T> res(ns.size());
+	vector<T> q(d + 1);
+	q[0] = 1;
+	for (int i = 0; i < d; ++i) {
+		q[i + 1] = -rec[i];
+	}
+	auto p0 = fft.multiply(vector<T>(initial.begin(), initial.begin() + d), q);
+	p0.resize(d);
+	vector<int> ids;
+	vector<long long> n;
+	vector<vector<T>> p;
+	for (int i = 0; i < (int)ns.size(); ++i) {
+		if (ns[i] < (long long)initial.size()) {
+			res[i] = initial[ns[i]];
+		} else if (d > 0) {
+			ids.push_back(i);
+			n.push_back(ns[i]);
+			p.push_back(p0);
+		}
+	}
+	int sz = 1;
+	while (sz < 2 * d) {
+		sz *= 2;
+	}
+	const bool native = fft.native_transform() && sz <= N;
+	while (!ids.empty()) {
+		auto qm = q;
+		for (int i = 1; i <= d; i += 2) {
+			qm[i] = -qm[i];
+		}
+		typename IFFT<T, Inner, N>::Transformed tqm;
+		vector<T> v;
+		if (native) {
+			// Q Q(-x) has degree 2d and its constant term is 1, so the cyclic product of size 2d is enough
+			tqm = fft.transform(qm, sz);
+			v = fft.restore(fft.transform(q, sz) * tqm);
+			if (sz == 2 * d) {
+				v.push_back(v[0] - 1);
+				v[0] = 1;
+			}
+		} else {
+			v = fft.multiply(q, qm);
+		}
+		int cnt = 0;
+		for (int j = 0; j < (int)ids.size(); ++j) {
+			const auto u = native ? fft.restore(fft.transform(move(p[j]), sz) * tqm) : fft.multiply(p[j], qm);
+			const int par = n[j] & 1;
+			p[j].assign(d, T(0));
+			for (int i = 0; i < d; ++i) {
+				p[j][i] = u[2 * i + par];
+			}
+			n[j] >>= 1;
+			if (n[j] == 0) {
+				res[ids[j]] = p[j][0];
+			} else {
+				if (cnt != j) {
+					ids[cnt] = ids[j];
+					n[cnt] = n[j];
+					p[cnt] = move(p[j]);
+				}
+				++cnt;
+			}
+		}
+		ids.resize(cnt);
+		n.resize(cnt);
+		p.resize(cnt);
+		for (int i = 0; i <= d; ++i) {
+			q[i] = v[2 * i];
+		}
+	}
+	return res;
+}
+
+template <typename T, typename Inner, int N>
+T get_nth_term_of_recurrence(const vector<T>& rec, const vector<T>& initial, long long n, IFFT<T, Inner, N>& fft) {
+	return get_nth_terms_of_recurrence(rec, initial, {n}, fft)[0];
+}
+
 template <typename T>
 T guess_nth_term(const vector<T>& a, long long n) {
 	auto rec = find_linear_recurrence(a);
 	return get_nth_term_of_recurrence(rec, a, n);
 }
+
+template <typename T, typename Inner, int N>
+T guess_nth_term(const vector<T>& a, long long n, IFFT<T, Inner, N>& fft) {
+	auto rec = find_linear_recurrence(a, fft);
+	return get_nth_term_of_recurrence(rec, a, n, fft);
+}
@@ -10,10 +10,14 @@
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
+#include <utility>
 
 #include "../base/sign.h"
+#include "montgomery.h"
+#include "ntt.h"
 
 using std::vector, std::strong_ordering;
+using std::min, std::max, std::move;
 
 struct BigInteger {
 	using u32 = uint32_t;
@@ -135,34 +139,242 @@ struct BigInteger {
 		shrink();
 	}
 
-	static vector<u32> _mul(const vector<u32>& a, const vector<u32>& b) {
-		if (a.empty() || b.empty()) {
-			return {};
+	// the products of limbs are accumulated in u64 and carried once per this many rows
+	static constexpr int ROWS = 16;
+	// min(|a|, |b|) from which Karatsuba is used; the NTT takes over from about 100 limbs with AVX2 and from 400 without,
+	// so Karatsuba is left for the scalar NTT and for the products longer than the transform
+	static constexpr int KARATSUBA = 160;
+
+	static int _ntt_min() {
+		static const int res = __builtin_cpu_supports("avx2") ? 96 : 400;
+		return res;
+	}
+
+	static void _trim(vector<u32>& dgs) {
+		while (!dgs.empty() && !dgs.back()) {
+			dgs.pop_back();
 		}
-		vector<u32> res(a.size() + b.size() - 1);
+	}
+
+	// acc[from, to) to the limbs < BASE, the carry goes to acc[to]
+	static void _carry(vector<u64>& acc, int from, int to) {
 		u64 carry = 0;
-		for (int i = 0; i < (int)a.size() + (int)b.size() - 1; ++i) {
-			res[i] = carry % BASE;
+		for (int i = from; i < to; ++i) {
+			carry += acc[i];
+			acc[i] = carry % BASE;
 			carry /= BASE;
-			int from = std::max(0, i - (int)b.size() + 1);
-			int to = std::min((int)a.size() - 1, i);
-			for (int j = from; j <= to; ++j) {
-				u64 tmp = (u64)a[j] * b[i - j];
-				carry += tmp / BASE;
-				res[i] += tmp % BASE;
-				if (res[i] >= BASE) {
-					res[i] -= BASE;
-					carry += 1;
-				}
+		}
+		acc[to] += carry;
+	}
+
+	static vector<u32> _from_acc(vector<u64>& acc) {
+		_carry(acc, 0, (int)acc.size() - 1);
+		vector<u32> res(acc.begin(), acc.end());
+		_trim(res);
+		return res;
+	}
+
+	static vector<u32> _mul_basic(const vector<u32>& a, const vector<u32>& b) {
+		const int n = a.size(), m = b.size();
+		vector<u64> acc(n + m + 1);
+		for (int i = 0; i < n; ++i) {
+			const u64 x = a[i];
+			u64* row = acc.data() + i;
+			for (int j = 0; j < m; ++j) {
+				row[j] += x * b[j];
+			}
+			if (i % ROWS == ROWS - 1) {
+				_carry(acc, i - ROWS + 1, i + m);
+			}
+		}
+		return _from_acc(acc);
+	}
+
+	// the products a_i a_j for i < j once, then doubled with the squares added
+	static vector<u32> _sqr_basic(const vector<u32>& a) {
+		const int n = a.size();
+		vector<u64> acc(2 * n + 1);
+		for (int i = 0; i < n; ++i) {
+			const u64 x = a[i];
+			u64* row = acc.data() + i;
+			for (int j = i + 1; j < n; ++j) {
+				row[j] += x * a[j];
 			}
+			if (i % ROWS == ROWS - 1) {
+				_carry(acc, 2 * (i - ROWS + 1) + 1, i + n);
+			}
+		}
+		_carry(acc, 0, 2 * n);
+		for (int i = 0; i < 2 * n; ++i) {
+			acc[i] *= 2;
 		}
-		while (carry > 0) {
-			res.push_back(carry % BASE);
+		for (int i = 0; i < n; ++i) {
+			acc[2 * i] += (u64)a[i] * a[i];
+		}
+		return _from_acc(acc);
+	}
+
+	// res += x B^shift, res is long enough
+	static void _add_at(vector<u32>& res, const vector<u32>& x, int shift) {
+		u32 carry = 0;
+		for (int i = 0; i < (int)x.size() || carry; ++i) {
+			carry += res[shift + i] + (i < (int)x.size() ? x[i] : 0);
+			res[shift + i] = carry % BASE;
 			carry /= BASE;
 		}
+	}
+
+	// res -= x, the result is non-negative
+	static void _sub_from(vector<u32>& res, const vector<u32>& x) {
+		u32 borrow = 0;
+		for (int i = 0; i < (int)x.size() || borrow; ++i) {
+			const u32 y = (i < (int)x.size() ? x[i] : 0) + borrow;
+			borrow = res[i] < y;
+			res[i] += (borrow ? BASE : 0) - y;
+		}
+	}
+
+	static vector<u32> _sum(const vector<u32>& a, int from, int mid, int to) {
+		vector<u32> res(max(mid - from, to - mid) + 1);
+		_add_at(res, vector<u32>(a.begin() + from, a.begin() + mid), 0);
+		_add_at(res, vector<u32>(a.begin() + mid, a.begin() + to), 0);
+		_trim(res);
 		return res;
 	}
 
+	static vector<u32> _part(const vector<u32>& a, int from, int to) {
+		vector<u32> res(a.begin() + min(from, (int)a.size()), a.begin() + min(to, (int)a.size()));
+		_trim(res);
+		return res;
+	}
+
+	// |a| >= |b|: the halves of a and b at h = |a| / 2, z1 = (a0 + a1)(b0 + b1) - z0 - z2.
+	// If b is not longer than h, it is multiplied by the pieces of a instead.
+	static vector<u32> _mul_karatsuba(const vector<u32>& a, const vector<u32>& b) {
+		const int n = a.size(), m = b.size();
+		vector<u32> res(n + m + 1);
+		const int h = (n + 1) / 2;
+		if (m <= h) {
+			// pieces as long as the transform allows, if they are multiplied by NTT
+			const int len = m >= _ntt_min() ? max(m, NTT_MAX + 1 - m) : m;
+			for (int i = 0; i < n; i += len) {
+				_add_at(res, _mul(_part(a, i, i + len), b), i);
+			}
+		} else {
+			const auto z0 = _mul(_part(a, 0, h), _part(b, 0, h));
+			const auto z2 = _mul(_part(a, h, n), _part(b, h, m));
+			auto z1 = _mul(_sum(a, 0, h, n), _sum(b, 0, h, m));
+			_sub_from(z1, z0);
+			_sub_from(z1, z2);
+			_trim(z1);
+			_add_at(res, z0, 0);
+			_add_at(res, z1, h);
+			_add_at(res, z2, 2 * h);
+		}
+		_trim(res);
+		return res;
+	}
+
+	static vector<u32> _sqr_karatsuba(const vector<u32>& a) {
+		const int n = a.size(), h = (n + 1) / 2;
+		vector<u32> res(2 * n + 1);
+		const auto z0 = _sqr(_part(a, 0, h));
+		const auto z2 = _sqr(_part(a, h, n));
+		auto z1 = _sqr(_sum(a, 0, h, n));
+		_sub_from(z1, z0);
+		_sub_from(z1, z2);
+		_trim(z1);
+		_add_at(res, z0, 0);
+		_add_at(res, z1, h);
+		_add_at(res, z2, 2 * h);
+		_trim(res);
+		return res;
+	}
+
+	// The limbs are convolved modulo three NTT primes: a coefficient is below min(|a|, |b|) BASE^2 < mod1 mod2 mod3.
+	// Garner gives x = r1 + mod1 w for w < mod2 mod3, which is split into the parts at BASE^0 and BASE^1 in u64.
+	static constexpr int mod1 = 167772161, mod2 = 469762049, mod3 = 754974721;
+	static constexpr int NTT_MAX = 1 << 24;
+
+	static constexpr u64 _power(u64 a, u64 p, u64 m) {
+		u64 res = 1;
+		for (; p; p >>= 1, a = a * a % m) {
+			if (p & 1) {
+				res = res * a % m;
+			}
+		}
+		return res;
+	}
+
+	template <int mod>
+	static vector<Montgomery<mod>> _convolve(const vector<u32>& a, const vector<u32>* b, int n) {
+		static NTT<mod, NTT_MAX> ntt;
+		vector<Montgomery<mod>> x(n);
+		for (int i = 0; i < (int)a.size(); ++i) {
+			x[i] = a[i];
+		}
+		auto tx = ntt.transform(move(x), n);
+		if (b) {
+			vector<Montgomery<mod>> y(n);
+			for (int i = 0; i < (int)b->size(); ++i) {
+				y[i] = (*b)[i];
+			}
+			tx *= ntt.transform(move(y), n);
+		} else {
+			tx *= tx;
+		}
+		return ntt.restore(move(tx));
+	}
+
+	static vector<u32> _mul_ntt(const vector<u32>& a, const vector<u32>* b) {
+		const int len = a.size() + (b ? b : &a)->size() - 1;
+		int n = 1;
+		while (n < len) {
+			n *= 2;
+		}
+		const auto r1 = _convolve<mod1>(a, b, n);
+		const auto r2 = _convolve<mod2>(a, b, n);
+		const auto r3 = _convolve<mod3>(a, b, n);
+		constexpr u64 c2 = _power(mod1, mod2 - 2, mod2), c3 = _power((u64)mod1 * mod2 % mod3, mod3 - 2, mod3);
+		vector<u64> acc(len + 2);
+		for (int i = 0; i < len; ++i) {
+			const u64 x1 = r1[i].get(), x2 = r2[i].get(), x3 = r3[i].get();
+			const u64 k2 = (x2 + mod2 - x1 % mod2) * c2 % mod2;
+			const u64 k3 = (x3 + 2 * (u64)mod3 - (x1 + mod1 * k2) % mod3) * c3 % mod3;
+			const u64 w = k2 + mod2 * k3;
+			acc[i] += x1 + mod1 * (w % BASE);
+			acc[i + 1] += mod1 * (w / BASE);
+		}
+		return _from_acc(acc);
+	}
+
+	static vector<u32> _sqr(const vector<u32>& a) {
+		const int n = a.size();
+		if (n >= _ntt_min() && 2 * n - 1 <= NTT_MAX) {
+			return _mul_ntt(a, nullptr);
+		}
+		// the halves of the schoolbook squaring make it faster than Karatsuba up to the NTT sizes
+		return n < _ntt_min() ? _sqr_basic(a) : _sqr_karatsuba(a);
+	}
+
+	// schoolbook, Karatsuba or NTT by the size of the shorter operand
+	static vector<u32> _mul(const vector<u32>& a, const vector<u32>& b) {
+		if (a.empty() || b.empty()) {
+			return {};
+		}
+		if (&a == &b) {
+			return _sqr(a);
+		}
+		if (a.size() < b.size()) {
+			return _mul(b, a);
+		}
+		const int m = b.size();
+		if (m >= _ntt_min() && (int)(a.size() + b.size()) - 1 <= NTT_MAX) {
+			return _mul_ntt(a, &b);
+		}
+		return m < KARATSUBA ? _mul_basic(a, b) : _mul_karatsuba(a, b);
+	}
+
 	static int _len(const vector<u32>& dgs) {
 		if (dgs.empty()) {
 			return 0;
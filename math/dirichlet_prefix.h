@@ -0,0 +1,116 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <vector>
+
+#include "../base/defines.h"
+#include "../base/util.h"
+#include "quotient_array.h"
+#include "sieve.h"
+
+using std::vector, std::min, std::max;
+
+// T(x) put together from pieces below 2^30, so a T built from int (e.g. Modular) gets x modulo its modulus
+template <typename T>
+T prefix_value(li x) {
+	if (x > -(1 << 30) && x < (1 << 30)) {
+		return T((int)x);
+	}
+	if (x < 0) {
+		return T(0) - prefix_value<T>(-x);
+	}
+	return prefix_value<T>(x >> 30) * T(1 << 30) + T((int)(x & ((1 << 30) - 1)));
+}
+
+// Let f * g = h (Dirichlet convolution), where g(1) = 1 and the prefix sums G and H of g and h are known for any x.
+// Then F(v) = H(v) - sum_{d=2}^{v} g(d) F(v / d) gives the prefix sums F of f for every v = [n/k].
+// f is sieved up to lim ~ n^{2/3} (given by its values f_pe(p, e, p^e) at prime powers), larger values are calculated
+// bottom-up in the increasing order, so the total time is O(n^{2/3}). T can be any ring type constructible from int,
+// the values up to n are brought to T with prefix_value.
+template <typename T, typename FuncPe, typename FuncG, typename FuncH>
+class DirichletPrefix {
+public:
+	const li n;
+	const li lim;
+	const FuncPe f_pe;
+	const FuncG g;
+	const FuncH h;
+
+	vector<T> small;	// small[x] = F(x) for x <= lim
+	QuotientArray<T> large;	// F(v) for v > lim
+
+	explicit DirichletPrefix(li _n, FuncPe&& _f_pe = FuncPe(), FuncG&& _g = FuncG(), FuncH&& _h = FuncH(), li _lim = 0):
+			n(_n), lim(_lim ? min(_lim, _n) : min<li>(_n, max<li>(isqrt(_n) + 1, pow(_n, 2. / 3)))),
+			f_pe(_f_pe), g(_g), h(_h), large(_n) {
+		assert(lim >= isqrt(n));
+		assert(lim <= INT_MAX);
+		const auto [vals] = sieve_multiplicative(lim, f_pe);
+		small.assign(lim + 1, T(0));
+		for (li i = 1; i <= lim; ++i) {
+			small[i] = small[i - 1] + prefix_value<T>(vals[i]);
+		}
+		for (int id = large.size() - 1; id >= 0; --id) {
+			const li v = large.value(id);
+			if (v <= lim) {
+				continue;
+			}
+			T res = h(v);
+			for (li l = 2, r; l <= v; l = r + 1) {
+				const li q = v / l;
+				r = v / q;
+				res -= (g(r) - g(l - 1)) * calc(q);
+			}
+			large[id] = res;
+		}
+	}
+
+	// F(v), v must be of the form [n/k]
+	T calc(li v) const {
+		return v <= lim ? small[v] : large.at(v);
+	}
+};
+
+// prefix sums of 1, [x = 1] and x for the common identities
+template <typename T>
+struct PrefixOne {
+	T operator ()(li x) const {
+		return prefix_value<T>(x);
+	}
+};
+
+template <typename T>
+struct PrefixUnit {
+	T operator ()(li x) const {
+		return T(x >= 1 ? 1 : 0);
+	}
+};
+
+template <typename T>
+struct PrefixId {
+	T operator ()(li x) const {
+		return x % 2 ? prefix_value<T>(x) * prefix_value<T>((x + 1) / 2) : prefix_value<T>(x / 2) * prefix_value<T>(x + 1);
+	}
+};
+
+struct MuPe {
+	int operator ()(li, int e, li) const {
+		return e == 1 ? -1 : 0;
+	}
+};
+
+struct PhiPe {
+	li operator ()(li p, int, li pe) const {
+		return pe / p * (p - 1);
+	}
+};
+
+// mu * 1 = [x = 1]: Mertens function
+template <typename T = LI>
+using MertensPrefix = DirichletPrefix<T, MuPe, PrefixOne<T>, PrefixUnit<T>>;
+
+// phi * 1 = id: sums of the totient function, ~0.304 n^2, so it overflows li already for n ~ 5.5e9
+template <typename T = LI>
+using TotientPrefix = DirichletPrefix<T, PhiPe, PrefixOne<T>, PrefixId<T>>;
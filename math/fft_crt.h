@@ -1,56 +1,123 @@
 #pragma once
 
+#include <cstdint>
+#include <tuple>
+
 #include "../base/traits.h"
 #include "fft_interface.h"
 #include "ntt.h"
 #include "montgomery.h"
-#include "crt.h"
 
+using std::tuple;
+
+// Products modulo any mod < 2^31 through three NTT-friendly primes. The operands are packed into the three residues
+// in one pass, every operand is transformed once per prime (once at all for squares), and the coefficients are
+// restored with Garner's algorithm in 64-bit Montgomery arithmetic.
 template <typename modulo_type, int N>
 class FFTCrt : public IFFT<modulo_type, modulo_type, N> {
 	static constexpr int mod1 = 167772161;	// 2^25
 	static constexpr int mod2 = 469762049;	// 2^26
 	static constexpr int mod3 = 754974721;	// 2^24
-	static constexpr LI modprod = (LI)mod1 * mod2 * mod3;
 	using Mint1 = Montgomery<mod1>;
 	using Mint2 = Montgomery<mod2>;
 	using Mint3 = Montgomery<mod3>;
+	using u64 = uint64_t;
 public:
 	vector<modulo_type> multiply(vector<modulo_type> a, vector<modulo_type> b) {
-		if (!this->initialized_) {
-			this->initialize();
-		}
-		vector<Mint1> a1(a.size()), b1(b.size());
-		vector<Mint2> a2(a.size()), b2(b.size());
-		vector<Mint3> a3(a.size()), b3(b.size());
-		for (int i = 0; i < (int)a.size(); ++i) {
-			a1[i] = a[i]();
-			a2[i] = a[i]();
-			a3[i] = a[i]();
-		}
-		for (int i = 0; i < (int)b.size(); ++i) {
-			b1[i] = b[i]();
-			b2[i] = b[i]();
-			b3[i] = b[i]();
-		}
-		auto r1 = ntt1.multiply(a1, b1);
-		auto r2 = ntt2.multiply(a2, b2);
-		auto r3 = ntt3.multiply(a3, b3);
-		vector<modulo_type> res(r1.size());
-		for (int i = 0; i < (int)res.size(); ++i) {
-			res[i] = (c1 * r1[i]() + c2 * r2[i]() + c3 * r3[i]()) % modprod % modulo_type::mod();
-		}
-		return res;
+		return product(a, a == b ? nullptr : &b);
 	}
 
-protected:
-	LI c1 = crt(vector<Remainder<LI>>{{mod1, 1}, {mod2, 0}, {mod3, 0}}).rem;
-	LI c2 = crt(vector<Remainder<LI>>{{mod1, 0}, {mod2, 1}, {mod3, 0}}).rem;
-	LI c3 = crt(vector<Remainder<LI>>{{mod1, 0}, {mod2, 0}, {mod3, 1}}).rem;
+	vector<modulo_type> square(const vector<modulo_type>& a) {
+		return product(a, nullptr);
+	}
+
+	bool native_transform() const {
+		return false;
+	}
 
+protected:
 	NTT<mod1, N> ntt1;
 	NTT<mod2, N> ntt2;
 	NTT<mod3, N> ntt3;
 
 	void fill_angles() {}
+
+private:
+	static constexpr u64 power(u64 a, u64 p, u64 m) {
+		u64 res = 1;
+		for (; p; p >>= 1, a = a * a % m) {
+			if (p & 1) {
+				res = res * a % m;
+			}
+		}
+		return res;
+	}
+
+	// k2 = (r2 - r1) / mod1 modulo mod2, k3 = (r3 - r1 - mod1 k2) / (mod1 mod2) modulo mod3;
+	// a Montgomery reduction of x R gives x, so the constants multiplied by the plain residues carry a factor R = 2^32
+	static constexpr u64 c2 = power(mod1, mod2 - 2, mod2), c2r = (c2 << 32) % mod2;
+	static constexpr u64 c3 = power((u64)mod1 * mod2 % mod3, mod3 - 2, mod3), c3r = (c3 << 32) % mod3;
+	static constexpr u64 c3r1 = c3r * mod1 % mod3;
+
+	static tuple<vector<Mint1>, vector<Mint2>, vector<Mint3>> pack(const vector<modulo_type>& a, int n) {
+		vector<Mint1> a1(n);
+		vector<Mint2> a2(n);
+		vector<Mint3> a3(n);
+		for (int i = 0; i < (int)a.size(); ++i) {
+			const long long x = a[i]();
+			a1[i] = x;
+			a2[i] = x;
+			a3[i] = x;
+		}
+		return {move(a1), move(a2), move(a3)};
+	}
+
+	static vector<modulo_type> restore(const vector<Mint1>& r1, const vector<Mint2>& r2, const vector<Mint3>& r3, int len) {
+		const u64 mod = modulo_type::mod();
+		const u64 mod12 = (u64)mod1 * mod2 % mod;
+		vector<modulo_type> res(len);
+		for (int i = 0; i < len; ++i) {
+			const u64 x1 = r1[i].get();
+			u64 k2 = Mint2::reduce(r2[i].x * c2 + (mod2 - x1) * c2r);
+			k2 -= k2 >= mod2 ? mod2 : 0;
+			u64 k3 = Mint3::reduce(r3[i].x * c3 + (mod3 - x1) * c3r + (mod3 - k2) * c3r1);
+			k3 -= k3 >= mod3 ? mod3 : 0;
+			res[i] = (x1 + mod1 * k2 + mod12 * k3) % mod;
+		}
+		return res;
+	}
+
+	vector<modulo_type> product(const vector<modulo_type>& a, const vector<modulo_type>* b) {
+		if (!this->initialized_) {
+			this->initialize();
+		}
+		if (a.empty() || (b && b->empty())) {
+			return {};
+		}
+		const int len = a.size() + (b ? b : &a)->size() - 1;
+		if (len > N) {
+			auto [a1, a2, a3] = pack(a, a.size());
+			auto [b1, b2, b3] = pack(b ? *b : a, (b ? b : &a)->size());
+			return restore(ntt1.multiply(a1, b1), ntt2.multiply(a2, b2), ntt3.multiply(a3, b3), len);
+		}
+		int n = 1;
+		while (n < len) {
+			n *= 2;
+		}
+		auto [a1, a2, a3] = pack(a, n);
+		auto t1 = ntt1.transform(move(a1), n);
+		auto t2 = ntt2.transform(move(a2), n);
+		auto t3 = ntt3.transform(move(a3), n);
+		if (b) {
+			auto [b1, b2, b3] = pack(*b, n);
+			t1 *= ntt1.transform(move(b1), n);
+			t2 *= ntt2.transform(move(b2), n);
+			t3 *= ntt3.transform(move(b3), n);
+		} else {
+			t1 *= t1;
+			t2 *= t2;
+			t3 *= t3;
+		}
+		return restore(ntt1.restore(move(t1)), ntt2.restore(move(t2)), ntt3.restore(move(t3)), len);
+	}
 };
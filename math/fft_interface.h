@@ -12,7 +12,7 @@
 
 using std::vector, std::pair;
 using std::max, std::min, std::swap;
-using std::is_convertible_v;
+using std::is_convertible_v, std::is_same_v, std::is_integral_v;
 using std::runtime_error;
 
 template <typename outer_type, typename inner_type, int N>
@@ -29,6 +29,9 @@ public:
 			return {};
 		}
 		if ((int)a.size() + (int)b.size() > N) {
+			if (native_transform()) {
+				return multiply_blocked(a, b);
+			}
 			Poly result(a.size() + b.size() - 1);
 			const int low_len = (max(a.size(), b.size()) + 1) / 2;
 			Poly a_low(a.begin(), min(a.begin() + low_len, a.end()));
@@ -89,7 +92,57 @@ public:
 		return res;
 	}
 
+	// a b for |a| + |b| > N: the operands are cut into blocks whose products fit into the transform of size N.
+	// Every block is transformed once, the products with the same offset are summed up before the inverse transform.
+	Poly multiply_blocked(const Poly& a, const Poly& b) {
+		if constexpr (native) {
+			const int la = a.size(), lb = b.size();
+			// either the shorter operand is a single block, or both are cut into halves of N
+			int ha = N / 2, hb = N / 2;
+			if (min(la, lb) <= N / 2) {
+				ha = la <= lb ? la : N + 1 - lb;
+				hb = la <= lb ? N + 1 - la : lb;
+			}
+			const int ca = (la + ha - 1) / ha, cb = (lb + hb - 1) / hb;
+			const auto cut = [&](const Poly& p, int h, int cnt) {
+				vector<vector<inner_type>> res(cnt, vector<inner_type>(N));
+				for (int i = 0; i < (int)p.size(); ++i) {
+					res[i / h][i % h] = p[i];
+				}
+				for (auto& r : res) {
+					fft(r);
+				}
+				return res;
+			};
+			const auto ta = cut(a, ha, ca), tb = cut(b, hb, cb);
+			Poly res(la + lb - 1);
+			vector<inner_type> acc(N);
+			for (int k = 0; k < ca + cb - 1; ++k) {
+				fill(all(acc), inner_type(0));
+				const int from = max(0, k - cb + 1), to = min(k, ca - 1);
+				for (int i = from; i <= to; ++i) {
+					const auto& x = ta[i];
+					const auto& y = tb[k - i];
+					for (int j = 0; j < N; ++j) {
+						acc[j] += x[j] * y[j];
+					}
+				}
+				ifft(acc);
+				const int shift = from * ha + (k - from) * hb;
+				for (int j = 0; j < N && shift + j < (int)res.size(); ++j) {
+					res[shift + j] += acc[j];
+				}
+			}
+			return res;
+		} else {
+			throw runtime_error("please, implement your own child multiply function");
+		}
+	}
+
 	virtual Poly square(const Poly& a) {
+		if (2 * (int)a.size() > N) {
+			return multiply(a, a);
+		}
 		int n = 1;
 		while (n < (int)a.size()) {
 			n *= 2;
@@ -115,6 +168,7 @@ public:
 		return res;
 	}
 
+	// the whole a^k, see below for the power modulo x^prec
 	virtual Poly pow(const Poly& a, int k) {
 		int n = 1;
 		while (n < (int)a.size() * k - k + 1) {
@@ -141,10 +195,128 @@ public:
 		return res;
 	}
 
+	// false for the children which do not multiply through their own fft, transform and restore are not available then
+	virtual bool native_transform() const {
+		return native;
+	}
+
+	// The image of a polynomial under the transform of size n. The pointwise product of images is the image
+	// of the product modulo x^n - 1, so an operand of several products is transformed only once.
+	struct Transformed {
+		vector<inner_type> a;
+
+		int size() const {
+			return a.size();
+		}
+
+		Transformed& operator *=(const Transformed& ot) {
+			assert(a.size() == ot.a.size());
+			for (int i = 0; i < (int)a.size(); ++i) {
+				a[i] *= ot.a[i];
+			}
+			return *this;
+		}
+
+		Transformed& operator +=(const Transformed& ot) {
+			assert(a.size() == ot.a.size());
+			for (int i = 0; i < (int)a.size(); ++i) {
+				a[i] += ot.a[i];
+			}
+			return *this;
+		}
+
+		friend Transformed operator *(Transformed x, const Transformed& y) {
+			x *= y;
+			return x;
+		}
+
+		friend Transformed operator +(Transformed x, const Transformed& y) {
+			x += y;
+			return x;
+		}
+	};
+
+	// p is taken modulo x^n - 1
+	Transformed transform(const Poly& p, int n) {
+		assert(native_transform());
+		assert(n > 0 && n <= N && !(n & (n - 1)));
+		vector<inner_type> a(n);
+		if constexpr (is_convertible_v<outer_type, inner_type>) {
+			for (int i = 0; i < (int)p.size(); ++i) {
+				a[i & (n - 1)] += p[i];
+			}
+		} else {
+			throw runtime_error("please, implement your own child transform function");
+		}
+		fft(a);
+		return {move(a)};
+	}
+
+	// the same, but the buffer of p is reused when possible
+	Transformed transform(Poly&& p, int n) {
+		if constexpr (is_same_v<outer_type, inner_type>) {
+			if ((int)p.size() <= n) {
+				assert(native_transform());
+				assert(n > 0 && n <= N && !(n & (n - 1)));
+				p.resize(n);
+				fft(p);
+				return {move(p)};
+			}
+		}
+		return transform(p, n);
+	}
+
+	// the polynomial of degree less than t.size() with the image t
+	Poly restore(Transformed t) {
+		ifft(t.a);
+		if constexpr (is_same_v<inner_type, outer_type>) {
+			return move(t.a);
+		} else if constexpr (is_convertible_v<inner_type, outer_type>) {
+			return Poly(all(t.a));
+		} else {
+			throw runtime_error("please, implement your own child restore function");
+		}
+	}
+
+	// The coefficients |b| - 1, ..., |a| - 1 of a b, i.e. res[i] = sum_j a[i + j] b[|b| - 1 - j] (the transposed product).
+	// Only a cyclic product of size |a| is needed, as the wrapped coefficients land below |b| - 1.
+	Poly middle_product(const Poly& a, const Poly& b) {
+		assert(!b.empty() && a.size() >= b.size());
+		int n = 1;
+		while (n < (int)a.size()) {
+			n *= 2;
+		}
+		if constexpr (native) {
+			if (native_transform() && n <= N) {
+				const auto c = restore(transform(a, n) * transform(b, n));
+				return Poly(c.begin() + b.size() - 1, c.begin() + a.size());
+			}
+		}
+		const auto c = multiply(a, b);
+		return Poly(c.begin() + b.size() - 1, c.begin() + a.size());
+	}
+
 	Poly inverse(const Poly& a, int prec) {
 		assert(!a.empty());
 		assert(a[0] != 0);
 		Poly b = {1 / a[0]};
+		if constexpr (native) {
+			if (native_transform() && 2 * prec <= N) {
+				for (int len = 1; len < prec; len *= 2) {
+					// a b = 1 + x^len e, the next len coefficients of b are -(b e) modulo x^len
+					const auto tb = transform(b, 2 * len);
+					auto h = restore(transform(Poly{a.begin(), a.begin() + min(2 * len, (int)a.size())}, 2 * len) * tb);
+					fill(h.begin(), h.begin() + len, outer_type(0));
+					h = restore(transform(h, 2 * len) * tb);
+					b.resize(2 * len);
+					for (int i = len; i < 2 * len; ++i) {
+						b[i] = -h[i];
+					}
+				}
+				b.resize(prec);
+				return b;
+			}
+		}
 		for (int len = 1; len < prec; len *= 2) {
 			auto tmp = multiply(b, b);
 			if ((int)tmp.size() > prec) {
@@ -175,8 +347,21 @@ public:
 
 	Poly primitive(Poly a) {
 		a.insert(a.begin(), 0);
-		for (int i = 1; i < (int)a.size(); ++i) {
-			a[i] /= i;
+		if constexpr (is_integral_v<outer_type>) {
+			for (int i = 1; i < (int)a.size(); ++i) {
+				a[i] /= i;
+			}
+		} else {
+			// all the divisions at once: 1 / i = (i - 1)! / i!
+			Poly fact(a.size(), outer_type(1));
+			for (int i = 2; i < (int)a.size(); ++i) {
+				fact[i] = fact[i - 1] * i;
+			}
+			outer_type inv = outer_type(1) / fact.back();
+			for (int i = (int)a.size() - 1; i > 0; --i) {
+				a[i] *= inv * fact[i - 1];
+				inv *= i;
+			}
 		}
 		return a;
 	}
@@ -184,7 +369,7 @@ public:
 	Poly log(const Poly& a, int prec) {
 		assert(!a.empty());
 		assert(a[0] == 1);
-		auto res = primitive(multiply(derivative(a), inverse(a, prec)));
+		auto res = primitive(multiply(derivative(Poly{a.begin(), a.begin() + min(prec, (int)a.size())}), inverse(a, prec)));
 		res.resize(prec);
 		return res;
 	}
@@ -193,6 +378,43 @@ public:
 		assert(!a.empty());
 		assert(a[0] == 0);
 		Poly b = {1};
+		if constexpr (native) {
+			if (native_transform() && 2 * prec <= N) {
+				// b = exp(a) and c = 1 / b modulo x^len
+				Poly c = {1};
+				const auto da = derivative(Poly{a.begin(), a.begin() + min(prec, (int)a.size())});
+				for (int len = 1; len < prec; len *= 2) {
+					const int n = 2 * len;
+					const auto tb = transform(b, n), tc = transform(c, n);
+					// e = b' - b a' = O(x^{len - 1}), so log(b) - a = integral of c e modulo x^n
+					auto e = restore(tb * transform(Poly{da.begin(), da.begin() + min(n - 1, (int)da.size())}, n));
+					for (int i = 0; i < n; ++i) {
+						e[i] = i < len - 1 || i == n - 1 ? outer_type(0) : -e[i];
+					}
+					auto f = restore(tc * transform(e, n));
+					fill(f.begin(), f.begin() + len - 1, outer_type(0));
+					f.pop_back();
+					auto g = primitive(f);
+					const auto bg = restore(tb * transform(g, n));
+					b.resize(n);
+					for (int i = len; i < n; ++i) {
+						b[i] = -bg[i];
+					}
+					if (n < prec) {
+						// the step of inverse
+						auto h = restore(transform(b, n) * tc);
+						fill(h.begin(), h.begin() + len, outer_type(0));
+						h = restore(transform(h, n) * tc);
+						c.resize(n);
+						for (int i = len; i < n; ++i) {
+							c[i] = -h[i];
+						}
+					}
+				}
+				b.resize(prec);
+				return b;
+			}
+		}
 		for (int len = 1; len < prec; len *= 2) {
 			auto tmp = Poly{a.begin(), a.begin() + min(2 * len, (int)a.size())};
 			tmp.resize(2 * len);
@@ -208,21 +430,138 @@ public:
 		return b;
 	}
 
+	// a^k modulo x^prec: the leading zeros are shifted out and a / (c x^t) is raised through log and exp
+	Poly pow(const Poly& a, li k, int prec) {
+		assert(k >= 0);
+		Poly res(prec);
+		if (prec == 0) {
+			return res;
+		}
+		if (k == 0) {
+			res[0] = 1;
+			return res;
+		}
+		int t = 0;
+		while (t < (int)a.size() && a[t] == 0) {
+			++t;
+		}
+		if (t == (int)a.size() || t >= (prec + k - 1) / k) {
+			return res;
+		}
+		const int shift = t * k, len = prec - shift;
+		const outer_type c = a[t], ic = 1 / c, ck = pw(c, k);
+		Poly b{a.begin() + t, a.begin() + min((int)a.size(), t + len)};
+		for (auto& x : b) {
+			x *= ic;
+		}
+		auto l = log(b, len);
+		// k as an element of outer_type, put together from pieces below 2^30 for the types built from int (e.g. Modular)
+		outer_type kk = 0;
+		for (int sh = 60; sh >= 0; sh -= 30) {
+			kk = kk * outer_type(1 << 30) + outer_type((int)((k >> sh) & ((1 << 30) - 1)));
+		}
+		for (auto& x : l) {
+			x *= kk;
+		}
+		const auto e = exp(l, len);
+		for (int i = 0; i < len; ++i) {
+			res[shift + i] = e[i] * ck;
+		}
+		return res;
+	}
+
+	// b with b^2 = a modulo x^prec, where r^2 is the first nonzero coefficient of a (its index has to be even)
+	Poly sqrt(const Poly& a, int prec, const outer_type& r = outer_type(1)) {
+		Poly res(prec);
+		int t = 0;
+		while (t < (int)a.size() && a[t] == 0) {
+			++t;
+		}
+		if (t == (int)a.size() || t / 2 >= prec) {
+			return res;
+		}
+		assert(t % 2 == 0);
+		assert(r * r == a[t]);
+		const int len = prec - t / 2;
+		const Poly s{a.begin() + t, a.begin() + min((int)a.size(), t + len)};
+		const outer_type half = outer_type(1) / 2;
+		Poly b = {r};
+		if constexpr (native) {
+			if (native_transform() && 2 * len <= N) {
+				// b = sqrt(s) and c = 1 / b modulo x^cur, then s - b^2 = x^cur d and the next coefficients are c d / 2
+				Poly c = {1 / r};
+				for (int cur = 1; cur < len; cur *= 2) {
+					const int n = 2 * cur;
+					const auto tb = transform(b, n), tc = transform(c, n);
+					const auto sq = restore(tb * tb);
+					Poly d(cur);
+					for (int i = cur; i < n; ++i) {
+						d[i - cur] = (i < (int)s.size() ? s[i] : outer_type(0)) - sq[i];
+					}
+					const auto e = restore(transform(move(d), n) * tc);
+					b.resize(n);
+					for (int i = cur; i < n; ++i) {
+						b[i] = e[i - cur] * half;
+					}
+					if (n < len) {
+						// the step of inverse
+						auto h = restore(transform(b, n) * tc);
+						fill(h.begin(), h.begin() + cur, outer_type(0));
+						h = restore(transform(h, n) * tc);
+						c.resize(n);
+						for (int i = cur; i < n; ++i) {
+							c[i] = -h[i];
+						}
+					}
+				}
+				copy_n(b.begin(), len, res.begin() + t / 2);
+				return res;
+			}
+		}
+		for (int cur = 1; cur < len; cur *= 2) {
+			const int n = 2 * cur;
+			auto tmp = multiply(Poly{s.begin(), s.begin() + min(n, (int)s.size())}, inverse(b, n));
+			tmp.resize(n);
+			b.resize(n);
+			for (int i = 0; i < n; ++i) {
+				b[i] = (b[i] + tmp[i]) * half;
+			}
+		}
+		copy_n(b.begin(), len, res.begin() + t / 2);
+		return res;
+	}
+
 	pair<Poly, Poly> divmod(Poly a, Poly b) {
 		assert(!b.empty());
 		assert(b.back() != 0);
 		if (a.size() < b.size()) {
 			return {{0}, a};
 		}
-		reverse(all(a));
-		reverse(all(b));
-		auto q = inverse(b, a.size() - b.size() + 1);
-		q = multiply(a, q);
-		q.resize(a.size() - b.size() + 1);
+		const int k = a.size() - b.size() + 1;
+		auto q = multiply(Poly{a.rbegin(), a.rbegin() + k}, inverse(Poly{b.rbegin(), b.rbegin() + min(k, (int)b.size())}, k));
+		q.resize(k);
 		reverse(all(q));
-		reverse(all(a));
-		reverse(all(b));
 		Poly r(b.size() - 1);
+		if (r.empty()) {
+			return {q, r};
+		}
+		int n = 1;
+		while (n < (int)r.size()) {
+			n *= 2;
+		}
+		if constexpr (native) {
+			if (native_transform() && n <= N) {
+				// r = a - bq has degree less than n, so it is enough to know it modulo x^n - 1
+				auto bq = restore(transform(b, n) * transform(q, n));
+				for (int i = 0; i < (int)a.size(); ++i) {
+					bq[i & (n - 1)] -= a[i];
+				}
+				for (int i = 0; i < (int)r.size(); ++i) {
+					r[i] = -bq[i];
+				}
+				return {q, r};
+			}
+		}
 		auto bq = multiply(b, q);
 		for (int i = 0; i < (int)r.size(); ++i) {
 			r[i] = a[i] - bq[i];
@@ -230,9 +569,264 @@ public:
 		return {q, r};
 	}
 
+	// a(x + c): i! [x^i] a(x + c) = sum_j a_j j! c^{j - i} / (j - i)!, a single product
+	Poly taylor_shift(const Poly& a, const outer_type& c) {
+		const int n = a.size();
+		if (n <= 1) {
+			return a;
+		}
+		const auto inv = primitive(Poly(n - 1, outer_type(1)));
+		Poly p(n), q(n);
+		outer_type fact = 1, ifact = 1, pc = 1;
+		for (int i = 0; i < n; ++i) {
+			if (i > 0) {
+				fact *= i;
+				ifact *= inv[i];
+				pc *= c;
+			}
+			p[n - 1 - i] = a[i] * fact;
+			q[i] = pc * ifact;
+		}
+		const auto r = multiply(p, q);
+		Poly res(n);
+		ifact = 1;
+		for (int i = 0; i < n; ++i) {
+			if (i > 0) {
+				ifact *= inv[i];
+			}
+			res[i] = r[n - 1 - i] * ifact;
+		}
+		return res;
+	}
+
+	// f(g) modulo x^prec in O(n log^2 n) (Kinoshita, Li). The composition is the transpose of the power projection
+	// w -> (sum_i w_i [x^i] g^j)_j, which is [x^{prec - 1}] A / B for A = rev(w), B = 1 - y g, found by the Bostan-Mori
+	// iteration A / B -> A B(-x, y) / B B(-x, y) keeping the powers of x of the parity of the target. So the products
+	// by B_t(-x, y) are done here backwards and transposed. At the step t the x-degrees are at most deg[t], B_t has
+	// y-degree 2^t and A_t has y-degree below 2^t; a bivariate p is stored with a stride s as p[i s + k] = [x^i y^k].
+	Poly composition(const Poly& f, const Poly& g, int prec) {
+		if (prec == 0 || f.empty()) {
+			return Poly(prec);
+		}
+		vector<int> deg = {prec - 1};
+		while (deg.back() > 0) {
+			deg.push_back(deg.back() / 2);
+		}
+		const int steps = (int)deg.size() - 1;
+		vector<Poly> bs(steps + 1);	// B_t with the stride 2^{t + 1}
+		bs[0].assign(2 * prec, outer_type(0));
+		bs[0][0] = 1;
+		for (int i = 0; i < min(prec, (int)g.size()); ++i) {
+			bs[0][2 * i + 1] = -g[i];
+		}
+		for (int t = 0; t < steps; ++t) {
+			// B_t B_t(-x, y) has y-degree 2d, but its y^0 column is 1, so with the stride 2d the y^{2d} column is read
+			// from the y^0 column of the next power of x
+			const int d = 1 << t;
+			Poly q{bs[t].begin(), bs[t].begin() + (deg[t] + 1) * 2 * d};
+			for (int i = 1; i <= deg[t]; i += 2) {
+				for (int k = 0; k <= d; ++k) {
+					q[i * 2 * d + k] = -q[i * 2 * d + k];
+				}
+			}
+			const auto r = multiply(bs[t], q);
+			bs[t + 1].assign((deg[t + 1] + 1) * 4 * d, outer_type(0));
+			bs[t + 1][0] = 1;
+			for (int i = 0; i <= deg[t + 1]; ++i) {
+				copy_n(r.begin() + 4 * i * d + 1, 2 * d, bs[t + 1].begin() + i * 4 * d + 1);
+			}
+		}
+		// A_steps(0, y) = [y^k] terms of the transposed f / B_steps(0, y) modulo y^|f|
+		const int top = 1 << steps;
+		const auto inv = inverse(Poly{bs[steps].begin(), bs[steps].begin() + top + 1}, f.size());
+		Poly fp(f);
+		fp.resize(f.size() + top - 1);
+		auto a = middle_product(fp, Poly{inv.rbegin(), inv.rend()});
+		for (int t = steps - 1; t >= 0; --t) {
+			const int d = 1 << t, s = 2 * d, par = deg[t] - 2 * deg[t + 1];
+			const int size = (deg[t] + 1) * s;
+			// the transposed product by B_t(-x, y): a_t[i s + k] = sum_j a_{t + 1}'[i s + k + j] B_t(-x, y)[j], which
+			// never carries between the powers of x for k < d
+			Poly p(2 * size - 1), q(deg[t] * s + d + 1);
+			for (int i = 0; i <= deg[t + 1]; ++i) {
+				copy_n(a.begin() + i * 2 * s, s, p.begin() + (2 * i + par) * s);
+			}
+			for (int i = 0; i <= deg[t]; ++i) {
+				for (int k = 0; k <= d; ++k) {
+					q[q.size() - 1 - i * s - k] = i % 2 ? -bs[t][i * s + k] : bs[t][i * s + k];
+				}
+			}
+			bs[t].clear();
+			bs[t].shrink_to_fit();
+			a = middle_product(p, q);
+		}
+		Poly res(prec);
+		for (int i = 0; i < prec; ++i) {
+			res[i] = a[(prec - 1 - i) * 2];
+		}
+		return res;
+	}
+
+	// Online convolution: the i-th call of push gets f_i and g_i and returns h_i = sum_j f_j g_{i - j}, so recurrences
+	// like f_{n + 1} = F(h_n) (e.g. f = 1 + x f^2) are computed in O(n log^2 n).
+	// The pairs (j, k) with j, k > 0 are covered by the blocks [mp, (m + 1)p) x [p, 2p) for m >= 2, their mirrored copies
+	// and the squares [p, 2p)^2, a block is multiplied as soon as its last element is pushed.
+	struct RelaxedConvolution {
+		IFFT* owner;
+		Poly f, g, h;
+		vector<Transformed> tf, tg;	// images of f[p, 2p) and g[p, 2p) of size 2p
+
+		explicit RelaxedConvolution(IFFT* that): owner(that) {}
+
+		outer_type push(const outer_type& a, const outer_type& b) {
+			const int i = f.size();
+			f.push_back(a);
+			g.push_back(b);
+			h.resize(2 * (i + 1));
+			h[i] += f[i] * g[0];
+			if (i > 0) {
+				h[i] += f[0] * g[i];
+			}
+			for (int p = 1; (i + 1) % p == 0 && 2 * p <= i + 1; p *= 2) {
+				add_block(p, (i + 1) / p - 1);
+			}
+			return h[i];
+		}
+
+	private:
+		// blocks smaller than this are multiplied naively
+		static constexpr int naive = 32;
+
+		static Poly slice(const Poly& a, int from, int len) {
+			return Poly{a.begin() + from, a.begin() + from + len};
+		}
+
+		void add_block(int p, int m) {
+			const int at = (m + 1) * p;
+			if (p < naive) {
+				for (int x = 0; x < p; ++x) {
+					for (int y = 0; y < p; ++y) {
+						h[at + x + y] += f[m * p + x] * g[p + y];
+						if (m > 1) {
+							h[at + x + y] += g[m * p + x] * f[p + y];
+						}
+					}
+				}
+				return;
+			}
+			Poly c;
+			if (owner->native_transform() && 2 * p <= N) {
+				const int k = __builtin_ctz(p / naive);
+				if (m == 1) {
+					tf.push_back(owner->transform(slice(f, p, p), 2 * p));
+					tg.push_back(owner->transform(slice(g, p, p), 2 * p));
+				}
+				c = owner->restore(m == 1 ? tf[k] * tg[k]
+						: owner->transform(slice(f, m * p, p), 2 * p) * tg[k] + owner->transform(slice(g, m * p, p), 2 * p) * tf[k]);
+			} else {
+				c = owner->multiply(slice(f, m * p, p), slice(g, p, p));
+				if (m > 1) {
+					const auto d = owner->multiply(slice(g, m * p, p), slice(f, p, p));
+					for (int i = 0; i < 2 * p - 1; ++i) {
+						c[i] += d[i];
+					}
+				}
+			}
+			for (int i = 0; i < 2 * p - 1; ++i) {
+				h[at + i] += c[i];
+			}
+		}
+	};
+
+	// Online convolution with g known in advance: the i-th call of push gets f_i and returns h_i = sum_j f_j g_{i - j}.
+	// The pairs (j, k) with k > 0 are covered by the blocks [mp, (m + 1)p) x [p, 2p), so only f is split into blocks
+	// and the image of g[p, 2p) is found once for every p.
+	struct SemiRelaxedConvolution {
+		IFFT* owner;
+		Poly f, g, h;
+		vector<Transformed> tg;	// images of g[p, 2p) of size 2p
+
+		SemiRelaxedConvolution(IFFT* that, Poly _g): owner(that), g(move(_g)) {}
+
+		outer_type push(const outer_type& a) {
+			const int i = f.size();
+			f.push_back(a);
+			h.resize(max((int)h.size(), i + 1));
+			if (!g.empty()) {
+				h[i] += a * g[0];
+			}
+			for (int p = 1; (i + 1) % p == 0 && p < (int)g.size(); p *= 2) {
+				add_block(p, (i + 1) / p - 1);
+			}
+			return h[i];
+		}
+
+	private:
+		// blocks smaller than this are multiplied naively
+		static constexpr int naive = 32;
+
+		Poly slice_g(int p) const {
+			Poly res{g.begin() + p, g.begin() + min(2 * p, (int)g.size())};
+			res.resize(p);
+			return res;
+		}
+
+		void add_block(int p, int m) {
+			const int at = (m + 1) * p;
+			h.resize(max((int)h.size(), at + 2 * p - 1));
+			if (p < naive) {
+				for (int y = p; y < min(2 * p, (int)g.size()); ++y) {
+					for (int x = 0; x < p; ++x) {
+						h[at + x + y - p] += f[m * p + x] * g[y];
+					}
+				}
+				return;
+			}
+			const Poly block{f.begin() + m * p, f.begin() + at};
+			Poly c;
+			if (owner->native_transform() && 2 * p <= N) {
+				const int k = __builtin_ctz(p / naive);
+				if ((int)tg.size() == k) {
+					tg.push_back(owner->transform(slice_g(p), 2 * p));
+				}
+				c = owner->restore(owner->transform(block, 2 * p) * tg[k]);
+			} else {
+				c = owner->multiply(block, slice_g(p));
+			}
+			for (int i = 0; i < 2 * p - 1; ++i) {
+				h[at + i] += c[i];
+			}
+		}
+	};
+
+	// exp(a) modulo x^prec from n f_n = sum_{k = 1}^{n} k a_k f_{n - k} by the semi-relaxed convolution in O(n log^2 n).
+	// Slower than exp for large prec, but does not need the Newton iterations.
+	Poly exp_relaxed(const Poly& a, int prec) {
+		assert(a.empty() || a[0] == 0);
+		Poly res(prec);
+		if (prec == 0) {
+			return res;
+		}
+		const auto inv = primitive(Poly(prec - 1, outer_type(1)));
+		Poly g(prec - 1);
+		for (int i = 1; i < min(prec, (int)a.size()); ++i) {
+			g[i - 1] = a[i] * i;
+		}
+		SemiRelaxedConvolution conv(this, move(g));
+		res[0] = 1;
+		for (int i = 1; i < prec; ++i) {
+			res[i] = conv.push(res[i - 1]) * inv[i];
+		}
+		return res;
+	}
+
+	// a[v] is the product of x - x_i over the leaves of v. For a segment of size s the children are multiplied modulo x^s - 1
+	// (a[v] is monic, so the wrap is easy to undo), t[u] keeps the image of a[u] of the size of its parent's segment.
+	// The same images serve the transposed products of multipoint and the products of interpolate.
 	struct ProductTree {
 		int n;
 		vector<Poly> a;
+		vector<Transformed> t;
 		vector<outer_type> x;
 		IFFT* owner;
 
@@ -242,17 +836,31 @@ public:
 				n *= 2;
 			}
 			a.resize(n + n);
+			t.resize(n + n);
 			outer_type one{1};
 			for (int i = 0; i < (int)x.size(); ++i) {
 				a[n + i] = {-x[i], one};
 			}
-			for (int i = n - 1; i > 0; --i) {
-				if (a[2 * i].empty()) {
+			for (int v = n - 1; v > 0; --v) {
+				if (a[2 * v].empty()) {
 					continue;
-				} else if (a[2 * i + 1].empty()) {
-					a[i] = a[2 * i];
+				} else if (a[2 * v + 1].empty()) {
+					a[v] = a[2 * v];
+					continue;
+				}
+				const int s = segment(v);
+				if (fast(s)) {
+					t[2 * v] = owner->transform(a[2 * v], s);
+					t[2 * v + 1] = owner->transform(a[2 * v + 1], s);
+					a[v] = owner->restore(t[2 * v] * t[2 * v + 1]);
+					if (count(2 * v) + count(2 * v + 1) == s) {
+						a[v][0] -= one;
+						a[v].push_back(one);
+					} else {
+						a[v].resize(count(2 * v) + count(2 * v + 1) + 1);
+					}
 				} else {
-					a[i] = owner->multiply(a[2 * i], a[2 * i + 1]);
+					a[v] = s <= naive ? naive_multiply(a[2 * v], a[2 * v + 1]) : owner->multiply(a[2 * v], a[2 * v + 1]);
 				}
 			}
 		}
@@ -261,68 +869,148 @@ public:
 			return a[1];
 		}
 
-		void rec_multipoint(int v, int l, int r, Poly p, vector<outer_type>& ans) {
-			if (l >= (int)x.size()) {
-				return;
+		// Transposed evaluation: the map p -> (p(x_i)) is the transpose of (c_i) -> sum c_i / (1 - x_i X) modulo X^|p|,
+		// whose numerators are summed up the tree as u_v = u_l rev(a_r) + u_r rev(a_l). So the root gets the transposed
+		// product of p and 1 / rev(a[1]), and every child gets the transposed product of its parent's u with its sibling.
+		vector<outer_type> multipoint(const Poly& p) {
+			vector<outer_type> ans(x.size());
+			if (x.empty() || p.empty()) {
+				return ans;
 			}
-			p = owner->divmod(p, a[v]).second;
-			if (r <= l + 64) {
-				for (int i = l; i < r && i < (int)x.size(); ++i) {
-					outer_type& res = ans[i] = 0;
-					for (int j = (int)p.size() - 1; j >= 0; --j) {
-						res = res * x[i] + p[j];
-					}
+			const int k = x.size(), m = p.size();
+			auto inv = owner->inverse(Poly(a[1].rbegin(), a[1].rend()), m);
+			reverse(all(inv));
+			Poly q(m + k - 1);
+			copy(all(p), q.begin());
+			descend(1, 0, owner->middle_product(q, inv), ans);
+			return ans;
+		}
+
+		// sum c_i prod_{j != i} (x - x_j)
+		Poly combine(const vector<outer_type>& c) {
+			if (x.empty()) {
+				return {};
+			}
+			return ascend(1, 0, c);
+		}
+
+	private:
+		// segments not larger than this are done naively
+		static constexpr int naive = 32;
+
+		int segment(int v) const {
+			return n >> (31 - __builtin_clz(v));
+		}
+
+		int count(int v) const {
+			return a[v].size() - 1;
+		}
+
+		bool fast(int s) const {
+			return s > naive && s <= N && owner->native_transform();
+		}
+
+		static Poly naive_multiply(const Poly& p, const Poly& q) {
+			Poly res(p.size() + q.size() - 1);
+			for (int i = 0; i < (int)p.size(); ++i) {
+				for (int j = 0; j < (int)q.size(); ++j) {
+					res[i + j] += p[i] * q[j];
 				}
+			}
+			return res;
+		}
+
+		// the coefficients |q| - 1, ..., |p| - 1 of pq
+		static Poly naive_middle(const Poly& p, const Poly& q) {
+			Poly res(p.size() - q.size() + 1);
+			for (int i = 0; i < (int)res.size(); ++i) {
+				for (int j = 0; j < (int)q.size(); ++j) {
+					res[i] += p[i + j] * q[q.size() - 1 - j];
+				}
+			}
+			return res;
+		}
+
+		// u has count(v) coefficients, l is the first leaf of v
+		void descend(int v, int l, Poly u, vector<outer_type>& ans) {
+			if (v >= n) {
+				ans[l] = u[0];
 				return;
 			}
-			int m = (l + r) / 2;
-			rec_multipoint(v + v, l, m, p, ans);
-			rec_multipoint(v + v + 1, m, r, p, ans);
+			const int s = segment(v);
+			if (a[2 * v + 1].empty()) {
+				descend(2 * v, l, move(u), ans);
+				return;
+			}
+			Poly ul, ur;
+			if (fast(s)) {
+				const auto tu = owner->transform(u, s);
+				const auto cl = owner->restore(tu * t[2 * v + 1]), cr = owner->restore(tu * t[2 * v]);
+				ul.assign(cl.begin() + count(2 * v + 1), cl.begin() + count(v));
+				ur.assign(cr.begin() + count(2 * v), cr.begin() + count(v));
+			} else if (s <= naive) {
+				ul = naive_middle(u, a[2 * v + 1]);
+				ur = naive_middle(u, a[2 * v]);
+			} else {
+				ul = owner->middle_product(u, a[2 * v + 1]);
+				ur = owner->middle_product(u, a[2 * v]);
+			}
+			u = {};
+			descend(2 * v, l, move(ul), ans);
+			descend(2 * v + 1, l + s / 2, move(ur), ans);
 		}
 
-		vector<outer_type> multipoint(const Poly& p) {
-			vector<outer_type> ans(x.size());
-			rec_multipoint(1, 0, n, p, ans);
-			return ans;
+		// the numerator of sum c_i / (x - x_i) over the leaves of v
+		Poly ascend(int v, int l, const vector<outer_type>& c) {
+			if (v >= n) {
+				return {c[l]};
+			}
+			const int s = segment(v);
+			if (a[2 * v + 1].empty()) {
+				return ascend(2 * v, l, c);
+			}
+			const auto left = ascend(2 * v, l, c), right = ascend(2 * v + 1, l + s / 2, c);
+			if (fast(s)) {
+				auto res = owner->restore(owner->transform(left, s) * t[2 * v + 1] + owner->transform(right, s) * t[2 * v]);
+				res.resize(count(v));
+				return res;
+			}
+			auto res = s <= naive ? naive_multiply(left, a[2 * v + 1]) : owner->multiply(left, a[2 * v + 1]);
+			const auto add = s <= naive ? naive_multiply(right, a[2 * v]) : owner->multiply(right, a[2 * v]);
+			for (int i = 0; i < (int)add.size(); ++i) {
+				res[i] += add[i];
+			}
+			return res;
 		}
 	};
 
-	Poly multipoint(Poly p, const vector<outer_type>& x) {
+	Poly multipoint(const Poly& p, const vector<outer_type>& x) {
 		ProductTree tree(x, this);
 		return tree.multipoint(p);
 	}
 
 	Poly interpolate(const vector<outer_type>& x, const vector<outer_type>& y) {
 		ProductTree tree(x, this);
-		auto denom = tree.multipoint(derivative(tree.top()));
-		auto inter = [&](const auto& self, int v, int l, int r) -> Poly {
-			if (l >= (int)x.size()) {
-				return {};
-			}
-			if (l + 1 == r) {
-				return {y[l] / denom[l]};
-			}
-			int m = (l + r) / 2;
-			auto left = self(self, v + v, l, m);
-			auto right = self(self, v + v + 1, m, r);
-			if (right.empty()) {
-				return left;
-			}
-			left = multiply(left, tree.a[v + v + 1]);
-			right = multiply(right, tree.a[v + v]);
-			if (left.size() < right.size()) {
-				left.resize(right.size());
-			}
-			for (int i = 0; i < (int)right.size(); ++i) {
-				left[i] += right[i];
-			}
-			return left;
-		};
-		return inter(inter, 1, 0, tree.n);
+		auto c = tree.multipoint(derivative(tree.top()));
+		// c_i = y_i / c_i with one division
+		Poly pref(c.size() + 1, outer_type(1));
+		for (int i = 0; i < (int)c.size(); ++i) {
+			pref[i + 1] = pref[i] * c[i];
+		}
+		outer_type inv = outer_type(1) / pref.back();
+		for (int i = (int)c.size() - 1; i >= 0; --i) {
+			const outer_type ci = c[i];
+			c[i] = y[i] * inv * pref[i];
+			inv *= ci;
+		}
+		return tree.combine(c);
 	}
 
 protected:
+	// the coefficients can be restored from the images directly, so the Newton iterations work with the images
+	static constexpr bool native = is_convertible_v<outer_type, inner_type> && is_convertible_v<inner_type, outer_type>;
 	static constexpr int L = 31 - __builtin_clz(N);
+
 	static_assert(!(N & (N - 1)));
 	vector<inner_type> angles;
 	vector<int> bitrev;
@@ -330,7 +1018,6 @@ protected:
 
 	void initialize() {
 		fill_angles();
-		fill_bitrev();
 		initialized_ = true;
 	}
 
@@ -352,6 +1039,9 @@ protected:
 		const int n = a.size();
 		assert(!(n & (n - 1)));
 		const int l = __builtin_ctz(n);
+		if (bitrev.empty()) {
+			fill_bitrev();
+		}
 
 		for (int i = 0; i < n; ++i) {
 			int j = revbit(i, l);
@@ -386,7 +1076,7 @@ protected:
 		}
 	}
 
-	void ifft(vector<inner_type>& a) {
+	virtual void ifft(vector<inner_type>& a) {
 		fft(a);
 		inner_type to_div = inner_type(1) / a.size();
 		for (auto& x : a) {
@@ -144,3 +144,193 @@ struct Montgomery {
 	}
 };
 
+
+// Montgomery arithmetic modulo an odd mod < 2^63, values are kept in [0, mod)
+struct Montgomery64Context {
+	using u64 = uint64_t;
+	using u128 = __uint128_t;
+
+	u64 mod, np, r2;	// mod * np = 1 modulo 2^64, r2 = 2^128 modulo mod
+
+	constexpr Montgomery64Context(): Montgomery64Context(1) {}
+
+	constexpr explicit Montgomery64Context(u64 _mod): mod(_mod), np(_mod), r2(-(u128)_mod % _mod) {
+		for (int i = 0; i < 5; ++i) {
+			np *= 2 - mod * np;
+		}
+	}
+
+	// x / 2^64 modulo mod for x < mod * 2^64: the low halves of x and m * mod coincide
+	constexpr u64 reduce(u128 x) const {
+		const u64 m = (u64)x * np;
+		const u64 hi = x >> 64, sub = ((u128)m * mod) >> 64;
+		return hi >= sub ? hi - sub : hi - sub + mod;
+	}
+
+	constexpr u64 mul(u64 a, u64 b) const {
+		return reduce((u128)a * b);
+	}
+
+	constexpr u64 add(u64 a, u64 b) const {
+		return a >= mod - b ? a - (mod - b) : a + b;
+	}
+
+	constexpr u64 sub(u64 a, u64 b) const {
+		return a >= b ? a - b : a + (mod - b);
+	}
+
+	constexpr u64 to(u64 x) const {
+		return mul(x % mod, r2);
+	}
+
+	constexpr u64 from(u64 x) const {
+		return reduce(x);
+	}
+
+	// a is in the Montgomery form, so is the result
+	constexpr u64 pow(u64 a, u64 p) const {
+		u64 res = to(1);
+		while (p) {
+			if (p & 1) {
+				res = mul(res, a);
+			}
+			p >>= 1;
+			a = mul(a, a);
+		}
+		return res;
+	}
+};
+
+// Holder::ctx is the context; for a mutable one the modulus can be changed by set_mod
+template <typename Holder>
+struct TypeMontgomery64 {
+	using u64 = uint64_t;
+
+	static constexpr const Montgomery64Context& ctx() {
+		return Holder::ctx;
+	}
+
+	static constexpr u64 mod() {
+		return ctx().mod;
+	}
+
+	static void set_mod(u64 m) {
+		Holder::ctx = Montgomery64Context(m);
+	}
+
+	u64 x;
+	TypeMontgomery64(): x(0) {}
+	constexpr TypeMontgomery64(long long y): x(ctx().to(y >= 0 ? y : y % (long long)mod() + mod())) {}
+
+	TypeMontgomery64& operator +=(const TypeMontgomery64& ot) {
+		x = ctx().add(x, ot.x);
+		return *this;
+	}
+
+	TypeMontgomery64& operator -=(const TypeMontgomery64& ot) {
+		x = ctx().sub(x, ot.x);
+		return *this;
+	}
+
+	TypeMontgomery64& operator *=(const TypeMontgomery64& ot) {
+		x = ctx().mul(x, ot.x);
+		return *this;
+	}
+
+	TypeMontgomery64& operator /=(const TypeMontgomery64& ot) {
+		return *this *= ot.inverse();
+	}
+
+	friend TypeMontgomery64 operator +(TypeMontgomery64 a, const TypeMontgomery64& b) {
+		a += b;
+		return a;
+	}
+
+	friend TypeMontgomery64 operator -(TypeMontgomery64 a, const TypeMontgomery64& b) {
+		a -= b;
+		return a;
+	}
+
+	friend TypeMontgomery64 operator *(TypeMontgomery64 a, const TypeMontgomery64& b) {
+		a *= b;
+		return a;
+	}
+
+	friend TypeMontgomery64 operator /(TypeMontgomery64 a, const TypeMontgomery64& b) {
+		a /= b;
+		return a;
+	}
+
+	TypeMontgomery64 operator -() const {
+		return TypeMontgomery64() - *this;
+	}
+
+	u64 get() const {
+		return ctx().from(x);
+	}
+
+	u64 operator ()() const {
+		return get();
+	}
+
+	// mod has to be prime
+	TypeMontgomery64 inverse() const {
+		return pow(mod() - 2);
+	}
+
+	TypeMontgomery64 inv() const {
+		return inverse();
+	}
+
+	TypeMontgomery64 pow(int64_t p) const {
+		if (p < 0) {
+			return pow(-p).inverse();
+		}
+		TypeMontgomery64 res;
+		res.x = ctx().pow(x, p);
+		return res;
+	}
+
+	friend istream& operator >>(istream& istr, TypeMontgomery64& m) {
+		long long x;
+		istr >> x;
+		m = TypeMontgomery64(x);
+		return istr;
+	}
+
+	friend ostream& operator <<(ostream& ostr, const TypeMontgomery64& m) {
+		return ostr << m.get();
+	}
+
+	bool operator ==(const TypeMontgomery64& ot) const {
+		return x == ot.x;
+	}
+
+	bool operator !=(const TypeMontgomery64& ot) const {
+		return x != ot.x;
+	}
+
+	explicit operator int64_t() const {
+		return get();
+	}
+
+	explicit operator bool() const {
+		return x;
+	}
+};
+
+template <uint64_t base>
+struct Montgomery64Holder {
+	static_assert(base % 2 == 1 && base < (1ull << 63));
+	static constexpr Montgomery64Context ctx = Montgomery64Context(base);
+};
+
+struct DynamicMontgomery64Holder {
+	static inline Montgomery64Context ctx = Montgomery64Context(1);
+};
+
+template <uint64_t base>
+using Montgomery64 = TypeMontgomery64<Montgomery64Holder<base>>;
+
+// The modulus is shared by all the values and is set by DynamicMontgomery64::set_mod(mod)
+using DynamicMontgomery64 = TypeMontgomery64<DynamicMontgomery64Holder>;
@@ -1,12 +1,31 @@
 #pragma once
 
+#include <cstdint>
+#include <immintrin.h>
+
 #include "fft_interface.h"
 #include "montgomery.h"
 
+// The forward transform goes from the large blocks to the small ones (radix-4 stages and one radix-2 stage if the number
+// of levels is odd) and leaves the values in the bit-reversed order, the inverse transform undoes the stages in the reverse
+// order, so no permutation is ever done. All the butterflies of a block share the twiddles, which are read contiguously.
+// If AVX2 is available, the butterflies run on 8 lanes, the last three levels are done on transposed 8x8 tiles.
 template <int mod, int N = (1 << __builtin_ctz(mod - 1))>
 class NTT : public IFFT<Montgomery<mod>, Montgomery<mod>, N> {
 	using Mint = Montgomery<mod>;
+
 protected:
+	// The s-th block of a level is split with r[s] = w^{rev(s)}, where w is the primitive N-th root and rev reverses
+	// L - 1 bits. The radix-4 butterfly of the s-th block uses t = r[2s] = r1[s], t^2 = r[s] and t^3 = r3[s].
+	// All the twiddles are kept in [0, mod).
+	struct Twiddles {
+		Mint imag;	// the 4th root of unity
+		vector<Mint> r, r1, r3;
+	};
+
+	Mint root;
+	Twiddles fw, bw;	// bw holds the inverses of fw
+
 	void fill_angles() {
 		vector<int> primes;
 		for (int x = mod - 1, p = 2; x > 1; ++p) {
@@ -33,16 +52,374 @@ protected:
 		while (!isPrimitiveRoot(g)) {
 			++g;
 		}
-		g = Mint(g).pow(mod / N).get();
+		root = Mint(g).pow(mod / N);
+		assert(root.pow(N) == 1 && (N == 1 || root.pow(N / 2) != 1));
 
-		this->angles.assign(N, 1);
-		for (int i = 1; i < N; ++i) {
-			this->angles[i] = this->angles[i - 1] * g;
-		}
-		assert(this->angles.back() * g == 1);
+		fw.imag = normalize(N >= 4 ? root.pow(N / 4) : 1);
+		bw.imag = normalize(fw.imag.inverse());
+		fw.r = bw.r = {normalize(1)};
+		fw.r1.clear();
+		fw.r3.clear();
+		bw.r1.clear();
+		bw.r3.clear();
 	}
 
 	void ntt(vector<Mint>& a) {
 		fft(a);
 	}
+
+	// the result is in the bit-reversed order
+	void fft(vector<Mint>& a) override {
+		if (!this->initialized_) {
+			this->initialize();
+		}
+		const int n = a.size();
+		assert(!(n & (n - 1)));
+		prepare(n);
+		if (n >= 64 && has_avx2()) {
+			forward_avx2(a.data(), n);
+			return;
+		}
+		const int h = __builtin_ctz(n);
+		int k = 0;
+		if (h % 2) {
+			forward2(a.data(), n / 2, 1);
+			k = 1;
+		}
+		for (; k < h; k += 2) {
+			forward4(a.data(), n >> (k + 2), 1 << k);
+		}
+	}
+
+	// takes the values in the bit-reversed order
+	void ifft(vector<Mint>& a) override {
+		if (!this->initialized_) {
+			this->initialize();
+		}
+		const int n = a.size();
+		assert(!(n & (n - 1)));
+		prepare(n);
+		const Mint to_div = normalize(Mint(n).inverse());
+		if (n >= 64 && has_avx2()) {
+			inverse_avx2(a.data(), n, to_div);
+			return;
+		}
+		const int h = __builtin_ctz(n);
+		for (int k = h - 2; k >= h % 2; k -= 2) {
+			inverse4(a.data(), n >> (k + 2), 1 << k);
+		}
+		if (h % 2) {
+			inverse2(a.data(), n / 2, 1);
+		}
+		for (auto& x : a) {
+			x *= to_div;
+		}
+	}
+
+private:
+	static Mint normalize(Mint x) {
+		if (x.x >= (uint32_t)mod) {
+			x.x -= mod;
+		}
+		return x;
+	}
+
+	static bool has_avx2() {
+		static const bool res = __builtin_cpu_supports("avx2");
+		return res;
+	}
+
+	// makes the twiddles for transforms of size n
+	void prepare(int n) {
+		for (int m = fw.r.size(); m < n / 2; m *= 2) {
+			const Mint c = root.pow(N / (4 * m)), ic = c.inverse();	// r[m] is the primitive (4m)-th root
+			fw.r.resize(2 * m);
+			bw.r.resize(2 * m);
+			for (int i = 0; i < m; ++i) {
+				fw.r[m + i] = normalize(fw.r[i] * c);
+				bw.r[m + i] = normalize(bw.r[i] * ic);
+			}
+		}
+		for (auto* w : {&fw, &bw}) {
+			for (int s = w->r1.size(); s < n / 4; ++s) {
+				w->r1.push_back(w->r[2 * s]);
+				w->r3.push_back(normalize(w->r[2 * s] * w->r[s]));
+			}
+		}
+	}
+
+	// blocks of size 2p
+	void forward2(Mint* a, int p, int blocks) const {
+		for (int s = 0; s < blocks; ++s, a += 2 * p) {
+			const Mint t = fw.r[s];
+			for (int i = 0; i < p; ++i) {
+				const Mint x = a[i], y = a[i + p] * t;
+				a[i] = x + y;
+				a[i + p] = x - y;
+			}
+		}
+	}
+
+	void inverse2(Mint* a, int p, int blocks) const {
+		for (int s = 0; s < blocks; ++s, a += 2 * p) {
+			const Mint t = bw.r[s];
+			for (int i = 0; i < p; ++i) {
+				const Mint x = a[i], y = a[i + p];
+				a[i] = x + y;
+				a[i + p] = (x - y) * t;
+			}
+		}
+	}
+
+	// blocks of size 4p
+	void forward4(Mint* a, int p, int blocks) const {
+		for (int s = 0; s < blocks; ++s, a += 4 * p) {
+			const Mint t1 = fw.r1[s], t2 = fw.r[s], t3 = fw.r3[s];
+			for (int i = 0; i < p; ++i) {
+				const Mint a0 = a[i], a1 = a[i + p] * t1, a2 = a[i + 2 * p] * t2, a3 = a[i + 3 * p] * t3;
+				const Mint s02 = a0 + a2, d02 = a0 - a2, s13 = a1 + a3, d13 = (a1 - a3) * fw.imag;
+				a[i] = s02 + s13;
+				a[i + p] = s02 - s13;
+				a[i + 2 * p] = d02 + d13;
+				a[i + 3 * p] = d02 - d13;
+			}
+		}
+	}
+
+	void inverse4(Mint* a, int p, int blocks) const {
+		for (int s = 0; s < blocks; ++s, a += 4 * p) {
+			const Mint t1 = bw.r1[s], t2 = bw.r[s], t3 = bw.r3[s];
+			for (int i = 0; i < p; ++i) {
+				const Mint c0 = a[i], c1 = a[i + p], c2 = a[i + 2 * p], c3 = a[i + 3 * p];
+				const Mint s01 = c0 + c1, d01 = c0 - c1, s23 = c2 + c3, d23 = (c2 - c3) * bw.imag;
+				a[i] = s01 + s23;
+				a[i + p] = (d01 + d23) * t1;
+				a[i + 2 * p] = (s01 - s23) * t2;
+				a[i + 3 * p] = (d01 - d23) * t3;
+			}
+		}
+	}
+
+	// AVX2 versions: the lanes hold Montgomery forms in [0, 2 mod), 4 mod < 2^32
+
+	__attribute__((target("avx2")))
+	static __m256i load(const Mint* p) {
+		return _mm256_loadu_si256((const __m256i*)p);
+	}
+
+	__attribute__((target("avx2")))
+	static void store(Mint* p, __m256i x) {
+		_mm256_storeu_si256((__m256i*)p, x);
+	}
+
+	__attribute__((target("avx2")))
+	static __m256i broadcast(Mint x) {
+		return _mm256_set1_epi32(x.x);
+	}
+
+	// [0, 4 mod) -> [0, 2 mod)
+	__attribute__((target("avx2")))
+	static __m256i shrink(__m256i x) {
+		return _mm256_min_epu32(x, _mm256_sub_epi32(x, _mm256_set1_epi32(2 * mod)));
+	}
+
+	__attribute__((target("avx2")))
+	static __m256i add(__m256i x, __m256i y) {
+		return shrink(_mm256_add_epi32(x, y));
+	}
+
+	// x - y + 2 mod, in [0, 4 mod)
+	__attribute__((target("avx2")))
+	static __m256i diff(__m256i x, __m256i y) {
+		return _mm256_add_epi32(_mm256_sub_epi32(x, y), _mm256_set1_epi32(2 * mod));
+	}
+
+	__attribute__((target("avx2")))
+	static __m256i sub(__m256i x, __m256i y) {
+		return shrink(diff(x, y));
+	}
+
+	// any x and t in [0, mod), the result is in [0, 2 mod)
+	__attribute__((target("avx2")))
+	static __m256i mul(__m256i x, __m256i t) {
+		const __m256i m = _mm256_set1_epi32(mod), np = _mm256_set1_epi32(Mint::np);
+		const __m256i even = _mm256_mul_epu32(x, t);
+		const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), _mm256_srli_epi64(t, 32));
+		const __m256i re = _mm256_add_epi64(even, _mm256_mul_epu32(_mm256_mul_epu32(even, np), m));
+		const __m256i ro = _mm256_add_epi64(odd, _mm256_mul_epu32(_mm256_mul_epu32(odd, np), m));
+		return _mm256_blend_epi32(_mm256_srli_epi64(re, 32), ro, 0b10101010);
+	}
+
+	__attribute__((target("avx2")))
+	static void butterfly2(__m256i& x, __m256i& y, __m256i t) {
+		const __m256i z = mul(y, t);
+		y = sub(x, z);
+		x = add(x, z);
+	}
+
+	__attribute__((target("avx2")))
+	static void inverse_butterfly2(__m256i& x, __m256i& y, __m256i t) {
+		const __m256i z = diff(x, y);
+		x = add(x, y);
+		y = mul(z, t);
+	}
+
+	__attribute__((target("avx2")))
+	static void butterfly4(__m256i& x0, __m256i& x1, __m256i& x2, __m256i& x3, __m256i t1, __m256i t2, __m256i t3,
+			__m256i imag) {
+		const __m256i a1 = mul(x1, t1), a2 = mul(x2, t2), a3 = mul(x3, t3);
+		const __m256i s02 = add(x0, a2), d02 = sub(x0, a2), s13 = add(a1, a3), d13 = mul(diff(a1, a3), imag);
+		x0 = add(s02, s13);
+		x1 = sub(s02, s13);
+		x2 = add(d02, d13);
+		x3 = sub(d02, d13);
+	}
+
+	__attribute__((target("avx2")))
+	static void inverse_butterfly4(__m256i& x0, __m256i& x1, __m256i& x2, __m256i& x3, __m256i t1, __m256i t2, __m256i t3,
+			__m256i imag) {
+		const __m256i s01 = add(x0, x1), d01 = sub(x0, x1), s23 = add(x2, x3), d23 = mul(diff(x2, x3), imag);
+		x0 = add(s01, s23);
+		x1 = mul(_mm256_add_epi32(d01, d23), t1);
+		x2 = mul(diff(s01, s23), t2);
+		x3 = mul(diff(d01, d23), t3);
+	}
+
+	// v[i] gets the i-th elements of the rows v[0..8)
+	__attribute__((target("avx2")))
+	static void transpose(__m256i* v) {
+		__m256i t[8], u[8];
+		for (int i = 0; i < 8; i += 2) {
+			t[i] = _mm256_unpacklo_epi32(v[i], v[i + 1]);
+			t[i + 1] = _mm256_unpackhi_epi32(v[i], v[i + 1]);
+		}
+		for (int i = 0; i < 8; i += 4) {
+			u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+			u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+			u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+			u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+		}
+		for (int i = 0; i < 4; ++i) {
+			v[i] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+			v[i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+		}
+	}
+
+	// the even and the odd elements of p[0..16)
+	__attribute__((target("avx2")))
+	static void split(const Mint* p, __m256i& even, __m256i& odd) {
+		const __m256i idx = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+		const __m256i x = _mm256_permutevar8x32_epi32(load(p), idx), y = _mm256_permutevar8x32_epi32(load(p + 8), idx);
+		even = _mm256_permute2x128_si256(x, y, 0x20);
+		odd = _mm256_permute2x128_si256(x, y, 0x31);
+	}
+
+	__attribute__((target("avx2")))
+	void forward_avx2(Mint* a, int n) const {
+		const int h = __builtin_ctz(n);
+		const __m256i imag = broadcast(fw.imag);
+		int k = 0;
+		if ((h - 3) % 2) {
+			for (int i = 0; i < n / 2; i += 8) {
+				__m256i x = load(a + i), y = load(a + n / 2 + i);
+				butterfly2(x, y, broadcast(fw.r[0]));
+				store(a + i, x);
+				store(a + n / 2 + i, y);
+			}
+			k = 1;
+		}
+		for (; k < h - 3; k += 2) {
+			const int p = n >> (k + 2);
+			for (int s = 0; s < (1 << k); ++s) {
+				const __m256i t1 = broadcast(fw.r1[s]), t2 = broadcast(fw.r[s]), t3 = broadcast(fw.r3[s]);
+				Mint* b = a + 4 * p * s;
+				for (int i = 0; i < p; i += 8) {
+					__m256i x0 = load(b + i), x1 = load(b + p + i), x2 = load(b + 2 * p + i), x3 = load(b + 3 * p + i);
+					butterfly4(x0, x1, x2, x3, t1, t2, t3, imag);
+					store(b + i, x0);
+					store(b + p + i, x1);
+					store(b + 2 * p + i, x2);
+					store(b + 3 * p + i, x3);
+				}
+			}
+		}
+		// the j-th lane of a tile is the block of size 8 number t + j
+		for (int t = 0; t < n / 8; t += 8) {
+			__m256i v[8];
+			for (int i = 0; i < 8; ++i) {
+				v[i] = load(a + 8 * (t + i));
+			}
+			transpose(v);
+			const __m256i r = load(&fw.r[t]);
+			for (int i = 0; i < 4; ++i) {
+				butterfly2(v[i], v[i + 4], r);
+			}
+			__m256i t1[2], t2[2], t3[2];
+			split(&fw.r1[2 * t], t1[0], t1[1]);
+			split(&fw.r[2 * t], t2[0], t2[1]);
+			split(&fw.r3[2 * t], t3[0], t3[1]);
+			for (int j = 0; j < 2; ++j) {
+				butterfly4(v[4 * j], v[4 * j + 1], v[4 * j + 2], v[4 * j + 3], t1[j], t2[j], t3[j], imag);
+			}
+			transpose(v);
+			for (int i = 0; i < 8; ++i) {
+				store(a + 8 * (t + i), v[i]);
+			}
+		}
+	}
+
+	__attribute__((target("avx2")))
+	void inverse_avx2(Mint* a, int n, Mint to_div) const {
+		const int h = __builtin_ctz(n);
+		const __m256i imag = broadcast(bw.imag);
+		for (int t = 0; t < n / 8; t += 8) {
+			__m256i v[8];
+			for (int i = 0; i < 8; ++i) {
+				v[i] = load(a + 8 * (t + i));
+			}
+			transpose(v);
+			__m256i t1[2], t2[2], t3[2];
+			split(&bw.r1[2 * t], t1[0], t1[1]);
+			split(&bw.r[2 * t], t2[0], t2[1]);
+			split(&bw.r3[2 * t], t3[0], t3[1]);
+			for (int j = 0; j < 2; ++j) {
+				inverse_butterfly4(v[4 * j], v[4 * j + 1], v[4 * j + 2], v[4 * j + 3], t1[j], t2[j], t3[j], imag);
+			}
+			const __m256i r = load(&bw.r[t]);
+			for (int i = 0; i < 4; ++i) {
+				inverse_butterfly2(v[i], v[i + 4], r);
+			}
+			transpose(v);
+			for (int i = 0; i < 8; ++i) {
+				store(a + 8 * (t + i), v[i]);
+			}
+		}
+		for (int k = h - 5; k >= (h - 3) % 2; k -= 2) {
+			const int p = n >> (k + 2);
+			for (int s = 0; s < (1 << k); ++s) {
+				const __m256i t1 = broadcast(bw.r1[s]), t2 = broadcast(bw.r[s]), t3 = broadcast(bw.r3[s]);
+				Mint* b = a + 4 * p * s;
+				for (int i = 0; i < p; i += 8) {
+					__m256i x0 = load(b + i), x1 = load(b + p + i), x2 = load(b + 2 * p + i), x3 = load(b + 3 * p + i);
+					inverse_butterfly4(x0, x1, x2, x3, t1, t2, t3, imag);
+					store(b + i, x0);
+					store(b + p + i, x1);
+					store(b + 2 * p + i, x2);
+					store(b + 3 * p + i, x3);
+				}
+			}
+		}
+		if ((h - 3) % 2) {
+			for (int i = 0; i < n / 2; i += 8) {
+				__m256i x = load(a + i), y = load(a + n / 2 + i);
+				inverse_butterfly2(x, y, broadcast(bw.r[0]));
+				store(a + i, x);
+				store(a + n / 2 + i, y);
+			}
+		}
+		const __m256i c = broadcast(to_div);
+		for (int i = 0; i < n; i += 8) {
+			store(a + i, mul(load(a + i), c));
+		}
+	}
 };
@@ -1,45 +1,115 @@
 #pragma once
 
+#include <array>
 #include <cassert>
+#include <climits>
+#include <random>
+#include <span>
+#include <utility>
 
 #include "../base/traits.h"
 #include "../base/util.h"
 #include "modular.h"
+#include "montgomery.h"
+
+using std::array, std::span, std::mt19937_64, std::pair;
 
 bool miller_rabin(long long n, long long a) {
 	if (gcd(a, n) > 1) {
 		return false;
 	}
+	if (n % 2 == 0) {
+		return n == 2;
+	}
+	const Montgomery64Context mt(n);
 	long long d = n - 1;
 	long long l = __builtin_ctzll(d);
 	d >>= l;
-	long long x = pw_big(a, d, n);
-	if (x == 1) {
+	const ull one = mt.to(1), minus_one = mt.to(n - 1);
+	ull x = mt.pow(mt.to(a), d);
+	if (x == one) {
 		return true;
 	}
 	while (l--) {
-		if (x == n - 1) {
+		if (x == minus_one) {
 			return true;
 		}
-		x = mult_big(x, x, n);
+		x = mt.mul(x, x);
 	}
 	return false;
 }
 
-bool is_prime(long long n, int iters = 30) {
-	// iters used to be 8, but it doesn't work here: https://dmoj.ca/problem/bf3hard
-	if (n == 1) {
-		return false;
+// One round for odd n > a; d * 2^l = n - 1 with odd d
+bool miller_rabin(const Montgomery64Context& mt, ull n, ull d, int l, ull a) {
+	const ull one = mt.to(1), minus_one = mt.to(n - 1);
+	ull x = mt.pow(mt.to(a), d);
+	if (x == one || x == minus_one) {
+		return true;
+	}
+	while (--l > 0) {
+		x = mt.mul(x, x);
+		if (x == minus_one) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Deterministic for all 64-bit n: small n are looked up, others are trial divided by a few primes
+// and checked with Miller-Rabin for a fixed set of bases.
+bool is_prime(long long n) {
+	constexpr int small = 1 << 16;
+	// bit i of small_odd_primes is set iff 2i + 1 is prime
+	static const auto small_odd_primes = []() {
+		vector<ull> bits(small / 128, ~0ull);
+		bits[0] &= ~1ull;
+		for (int i = 3; i * i < small; i += 2) {
+			if (bits[i / 128] >> (i / 2 % 64) & 1) {
+				for (int j = i * i; j < small; j += 2 * i) {
+					bits[j / 128] &= ~(1ull << (j / 2 % 64));
+				}
+			}
+		}
+		return bits;
+	}();
+	if (n < small) {
+		return n == 2 || (n > 2 && n % 2 == 1 && (small_odd_primes[n / 128] >> (n / 2 % 64) & 1));
 	}
 	if (n % 2 == 0) {
-		return n == 2;
+		return false;
 	}
-	for (int i = 2; i < n && i < iters; ++i) {
-		if (!miller_rabin(n, i)) {
+	// n is divisible by an odd p iff n * p^{-1} <= (2^64 - 1) / p modulo 2^64
+	static constexpr array<ull, 14> trial = {3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47};
+	static constexpr auto trial_inv = []() {
+		array<ull, trial.size()> res{};
+		for (int i = 0; i < (int)trial.size(); ++i) {
+			ull x = trial[i];
+			for (int it = 0; it < 5; ++it) {
+				x *= 2 - trial[i] * x;
+			}
+			res[i] = x;
+		}
+		return res;
+	}();
+	for (int i = 0; i < (int)trial.size(); ++i) {
+		if ((ull)n * trial_inv[i] <= ULLONG_MAX / trial[i]) {
 			return false;
 		}
 	}
-	return true;
+	const Montgomery64Context mt(n);
+	const ull d = (n - 1) >> __builtin_ctzll(n - 1);
+	const int l = __builtin_ctzll(n - 1);
+	static constexpr array<ull, 3> bases32 = {2, 7, 61};
+	static constexpr array<ull, 7> bases64 = {2, 325, 9375, 28178, 450775, 9780504, 1795265022};
+	const auto check = [&](const auto& bases) {
+		for (ull a : bases) {
+			if (!miller_rabin(mt, n, d, l, a)) {
+				return false;
+			}
+		}
+		return true;
+	};
+	return n < (1ll << 32) ? check(bases32) : check(bases64);
 }
 
 // https://citeseerx.ist.psu.edu/viewdoc/download;jsessionid=0BBDB8D8B214E24EE2113ED076A8625F?doi=10.1.1.107.9984&rep=rep1&type=pdf
@@ -176,42 +246,162 @@ ull squfof(ull n) {
 	assert(false);
 }
 
-vector<long long> factorize_rho(long long n) {
-	vector<long long> res;
-	for (long long d : {2, 3, 5}) {
-		while (n % d == 0) {
-			n /= d;
-			res.push_back(d);
+ull binary_gcd(ull a, ull b) {
+	if (!a || !b) {
+		return a | b;
+	}
+	const int sh = __builtin_ctzll(a | b);
+	a >>= __builtin_ctzll(a);
+	while (b) {
+		b >>= __builtin_ctzll(b);
+		if (a > b) {
+			swap(a, b);
 		}
+		b -= a;
 	}
-	if (n == 1) {
-		return res;
+	return a << sh;
+}
+
+// Brent's variant of Pollard's rho for L composite numbers at once. The walks of the lanes are interleaved,
+// so the latencies of their independent multiplications overlap.
+// Every walk multiplies the differences x - y for `block` steps before taking a gcd and replays the block
+// if the gcd is n; a number which needs more than max_steps steps is split by squfof.
+template <int L>
+class RhoLanes {
+public:
+	static constexpr int block = 128;
+	static constexpr int max_steps = 1 << 22;
+
+	// on_factor(task, d) is called with a nontrivial divisor d of the number of task
+	template <typename Next, typename OnFactor>
+	void run(const Next& next, const OnFactor& on_factor) {
+		int active = 0;
+		for (int l = 0; l < L; ++l) {
+			active += take(l, next);
+		}
+		while (active) {
+			{
+				// local copies let the compiler keep all the lanes in registers
+				Montgomery64Context lmt[L];
+				ull ly[L], lq[L], lx[L], lc[L];
+				for (int l = 0; l < L; ++l) {
+					ys[l] = ly[l] = y[l];
+					lmt[l] = mt[l], lq[l] = q[l], lx[l] = x[l], lc[l] = c[l];
+				}
+				for (int i = 0; i < block; ++i) {
+					for (int l = 0; l < L; ++l) {
+						ly[l] = lmt[l].add(lmt[l].mul(ly[l], ly[l]), lc[l]);
+						lq[l] = lmt[l].mul(lq[l], lmt[l].sub(lx[l], ly[l]));
+					}
+				}
+				for (int l = 0; l < L; ++l) {
+					y[l] = ly[l], q[l] = lq[l];
+				}
+			}
+			for (int l = 0; l < L; ++l) {
+				if (task[l] == -1) {
+					active += take(l, next);
+					continue;
+				}
+				const ull n = mt[l].mod;
+				ull g = binary_gcd(q[l], n);
+				if (g == n) {
+					// the factor was found in the middle of the block
+					for (int i = 0; i < block; ++i) {
+						ys[l] = mt[l].add(mt[l].mul(ys[l], ys[l]), c[l]);
+						if ((g = binary_gcd(mt[l].sub(x[l], ys[l]), n)) != 1) {
+							break;
+						}
+					}
+				}
+				steps[l] += block;
+				if (g != 1 && g != n) {
+					on_factor(task[l], g);
+				} else if (steps[l] >= max_steps) {
+					on_factor(task[l], squfof(n));
+				} else {
+					if (g == n) {
+						restart(l);
+					} else if ((steps[l] & (steps[l] - 1)) == 0) {
+						x[l] = y[l];
+					}
+					continue;
+				}
+				active -= !take(l, next);
+			}
+		}
 	}
-	if (is_prime(n)) {
-		res.push_back(n);
-		return res;
+
+private:
+	Montgomery64Context mt[L];
+	ull c[L], x[L], y[L], ys[L], q[L];
+	int task[L], steps[L];
+	mt19937_64 rng{2281488};
+
+	template <typename Next>
+	bool take(int l, const Next& next) {
+		auto [t, n] = next();
+		task[l] = t;
+		mt[l] = Montgomery64Context(t == -1 ? 3 : n);
+		steps[l] = 0;
+		restart(l);
+		return t != -1;
 	}
-	while (true) {
-		long long x1 = rand() % (n - 1) + 1;
-		long long x2 = (mult_big(x1, x1, n) + 1) % n;
-		while (true) {
-			long long c = (x1 - x2 + n) % n;
-			if (c == 0) {
-				break;
-			}
-			long long g = gcd(c, n);
-			if (g > 1) {
-				auto tmp = factorize_rho(g);
-				res.insert(res.end(), all(tmp));
-				tmp = factorize_rho(n / g);
-				res.insert(res.end(), all(tmp));
-				return res;
+
+	void restart(int l) {
+		const ull n = mt[l].mod;
+		c[l] = mt[l].to(rng() % (n - 1) + 1);
+		x[l] = y[l] = mt[l].to(rng() % n);
+		q[l] = mt[l].to(1);
+	}
+};
+
+// Factorizes all the numbers (1 <= n < 2^63, as for factorize); composites left after the trial division are split
+// by rho, L of them at a time
+template <int L = 4>
+vector<vector<long long>> factorize_many(span<const long long> ns) {
+	vector<vector<long long>> res(ns.size());
+	vector<pair<int, ull>> composites;
+	const auto add = [&](int id, ull n) {
+		if (is_prime(n)) {
+			res[id].push_back(n);
+		} else {
+			composites.push_back({id, n});
+		}
+	};
+	for (int id = 0; id < (int)ns.size(); ++id) {
+		assert(ns[id] > 0);
+		ull n = ns[id];
+		for (ull d : {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47}) {
+			while (n % d == 0) {
+				n /= d;
+				res[id].push_back(d);
 			}
-			x1 = (mult_big(x1, x1, n) + 1) % n;
-			x2 = (mult_big(x2, x2, n) + 1) % n;
-			x2 = (mult_big(x2, x2, n) + 1) % n;
+		}
+		if (n > 1) {
+			add(id, n);
 		}
 	}
+	// a task is a composite being split, its divisors are put back to the pool
+	vector<pair<int, ull>> tasks;
+	RhoLanes<L> rho;
+	rho.run([&]() -> pair<int, ull> {
+		if (composites.empty()) {
+			return {-1, 0};
+		}
+		tasks.push_back(composites.back());
+		composites.pop_back();
+		return {(int)tasks.size() - 1, tasks.back().second};
+	}, [&](int t, ull d) {
+		const auto [id, n] = tasks[t];
+		add(id, d);
+		add(id, n / d);
+	});
+	return res;
+}
+
+vector<long long> factorize_rho(long long n) {
+	return factorize_many<1>(span<const long long>(&n, 1))[0];
 }
 
 vector<long long> factorize(long long n) {
@@ -1,17 +1,23 @@
 #pragma once
 
 #include <algorithm>
+#include <barrier>
+#include <cassert>
 #include <numeric>
+#include <span>
 
 #include "prime_count_cheat.h"
 #include "prime_count_mine.h"
+#include "prime_count_dr.h"
 
 #include "sieve.h"
+#include "quotient_array.h"
 #include "modular.h"
 #include "../base/util.h"
+#include "../base/parallel.h"
 #include "../ds/fenwick.h"
 
-using std::max, std::min, std::iota;
+using std::max, std::min, std::iota, std::span, std::barrier;
 
 // Let h be a completely multiplicative function, hp(n) = sum_{i=1}^n h(i).
 // Then this class allows one to calculate sum_{i=1}^{[n/k]} [i is prime] * h(i) for every k.
@@ -24,26 +30,43 @@ public:
 	const FuncH h;
 	const FuncHp hp;
 
-	const T def = 2281488;
-
 	vector<int> erat, primes;
 	vector<int> sorted_numbers;
-	vector<vector<T>> dp;
+	// dp(i, j) is defined for 1 <= i < rows, 0 <= j < row_size[i]; row sizes do not increase with i,
+	// so the cells are stored by columns: column j holds the rows [1, col_rows[j]) starting from col_start[j] + 1.
+	// This way the level-by-level sweep of fill_dp reads every column sequentially.
+	int rows;
+	vector<int> row_size, col_rows;
+	vector<li> col_start;
+	vector<T> cells;
+	vector<bool> computed, pending;	// pending: expanded by fill_queries, to be calculated by calc_queries
 	vector<T> prec;
 	vector<T> h_small;
 
 	explicit PrimePrefix(li _n, FuncH&& _h = FuncH(), FuncHp&& _hp = FuncHp()): n(_n), K(max({20., pow(n / max(1., log(n)), 2. / 3), sqrt(n) + 100})), h(_h), hp(_hp) {
 		tie(erat, primes) = sieve(K);
-		dp.resize(n / (K - 1) + 1);
+		row_size.assign(1, 0);
 		for (int i = 1, j = (int)primes.size() - 1; n / i >= K; ++i) {
 			while (j > 0 && sqr(primes[j - 1]) > n / i) {
 				--j;
 			}
-			dp[i].assign(j + 2, def);
+			row_size.push_back(j + 2);
+		}
+		rows = row_size.size();
+		col_rows.resize(rows > 1 ? row_size[1] : 0);
+		for (int j = 0, i = rows - 1; j < (int)col_rows.size(); ++j) {
+			while (row_size[i] <= j) {
+				--i;
+			}
+			col_rows[j] = i + 1;
 		}
-		while (!dp.empty() && dp.back().empty()) {
-			dp.pop_back();
+		col_start.assign(col_rows.size() + 1, -1);
+		for (int j = 0; j < (int)col_rows.size(); ++j) {
+			col_start[j + 1] = col_start[j] + col_rows[j] - 1;
 		}
+		cells.assign(col_start.back() + 1, 0);
+		computed.assign(cells.size(), false);
+		pending.assign(cells.size(), false);
 		sorted_numbers.resize(K - 1);
 		iota(all(sorted_numbers), 1);
 		sort(all(sorted_numbers), [&](int i, int j) {
@@ -64,120 +87,204 @@ public:
 	}
 
 	struct Query {
-		int id;
 		int n;
 		int k;
-		T ans;
 	};
 
-	void fill_dp() {
-		if (dp.empty()) {
+	li cell(li i, int j) const {
+		return col_start[j] + i;
+	}
+
+	// The rows of every level are split between threads, which meet at a barrier before the Fenwick tree changes;
+	// levels with few rows are processed by the calling thread alone.
+	void fill_dp(int threads = 1) {
+		if (rows <= 1) {
 			return;
 		}
 		Fenwick<T> f(K);
 		for (int i = 1; i < K; ++i) {
 			f.add(i, h_small[i]);
 		}
-		for (auto& v : dp) {
-			fill(all(v), 0);
-		}
+		fill(all(cells), 0);
 		int idx = (int)sorted_numbers.size() - 2;
-		for (int j = 0; j < (int)dp[1].size(); ++j) {
-			for (int i = 1; i < (int)dp.size() && j < (int)dp[i].size(); ++i) {
-				if (j > 0 && n / i >= K && 1ll * i * primes[j - 1] >= (int)dp.size()) {
-					dp[i][j] -= f.get(n / i / primes[j - 1]) * h(primes[j - 1]);
+		const int cols = col_rows.size();
+		// needs the tree before the numbers with the least prime primes[j] are removed
+		const auto subtract_large = [&](int j, int from, int to) {
+			if (j == 0) {
+				return;
+			}
+			T* col = cells.data() + col_start[j];
+			for (int i = from; i < to; ++i) {
+				if (n / i >= K && 1ll * i * primes[j - 1] >= rows) {
+					col[i] -= f.get(n / i / primes[j - 1]) * h(primes[j - 1]);
 				}
 			}
+		};
+		const auto remove_numbers = [&](int j) {
 			while (idx >= 0 && erat[sorted_numbers[idx]] < primes[j]) {
 				f.add(sorted_numbers[idx], -h_small[sorted_numbers[idx]]);
 				--idx;
 			}
-			for (int i = 1; i < (int)dp.size() && j < (int)dp[i].size(); ++i) {
+		};
+		const auto add_rest = [&](int j, int from, int to) {
+			T* col = cells.data() + col_start[j];
+			for (int i = from; i < to; ++i) {
 				if (j == 0) {
-					dp[i][j] += hp(n / i);
+					col[i] += hp(n / i);
 				} else if (n / i < K) {
-					dp[i][j] += f.get(n / i);
+					col[i] += f.get(n / i);
 				} else {
-					dp[i][j] += dp[i][j - 1];
-					if (li ni = 1ll * i * primes[j - 1]; ni < (int)dp.size()) {
-						int mn = min(j - 1, (int)dp[ni].size() - 1);
-						dp[i][j] -= (dp[ni][mn] + prec[primes[mn] - 1] - prec[primes[j - 1] - 1]) * h(primes[j - 1]);
+					col[i] += cells[cell(i, j - 1)];
+					if (li ni = 1ll * i * primes[j - 1]; ni < rows) {
+						int mn = min(j - 1, row_size[ni] - 1);
+						col[i] -= (cells[cell(ni, mn)] + prec[primes[mn] - 1] - prec[primes[j - 1] - 1]) * h(primes[j - 1]);
 					}
 				}
 			}
+		};
+		// a level is split only if every thread gets at least this many rows
+		constexpr int min_rows = 1 << 12;
+		int par = 0;
+		while (threads > 1 && par < cols && col_rows[par] >= (li)min_rows * threads) {
+			++par;
+		}
+		if (par > 0) {
+			barrier sync(threads);
+			run_threads(threads, [&](int t) {
+				for (int j = 0; j < par; ++j) {
+					const int from = 1 + (li)(col_rows[j] - 1) * t / threads;
+					const int to = 1 + (li)(col_rows[j] - 1) * (t + 1) / threads;
+					subtract_large(j, from, to);
+					sync.arrive_and_wait();
+					if (t == 0) {
+						remove_numbers(j);
+					}
+					sync.arrive_and_wait();
+					add_rest(j, from, to);
+				}
+			});
+		}
+		for (int j = par; j < cols; ++j) {
+			subtract_large(j, 1, col_rows[j]);
+			remove_numbers(j);
+			add_rest(j, 1, col_rows[j]);
 		}
+		fill(computed.begin(), computed.end(), true);
 	}
 
 	T calc(long long i) {
-		if (n / i < (int)prec.size()) {
-			return prec[n / i];
-		}
+		return calc_many(span<const li>(&i, 1))[0];
+	}
+
+	// The answers for all the i-s at once: the leaf queries of all of them are answered by a single sweep
+	vector<T> calc_many(span<const li> is) {
 		vector<Query> qrs;
-		fill_queries(i, (int)dp[i].size(), qrs);
-		if (!qrs.empty()) {
-			sort(all(qrs), [&](const Query& a, const Query& b) {
-				return a.k > b.k;
-			});
-			Fenwick<T> f(K);
-			f.add(1, 1);
-			int idx = 0;
-			for (int k : sorted_numbers) {
-				if (idx >= (int)qrs.size()) {
-					break;
-				}
-				while (idx < (int)qrs.size() && erat[k] < primes[qrs[idx].k]) {
-					qrs[idx].ans = f.get(qrs[idx].n);
-					++idx;
-				}
-				f.add(k, h_small[k]);
+		for (li i : is) {
+			if (n / i >= (int)prec.size()) {
+				fill_queries(i, row_size[i], qrs);
 			}
-			while (idx < (int)qrs.size()) {
-				qrs[idx].ans = f.get(qrs[idx].n);
-				++idx;
+		}
+		const auto answers = answer_queries(qrs);
+		int ptr = 0;
+		vector<T> res(is.size());
+		for (int t = 0; t < (int)is.size(); ++t) {
+			const li i = is[t];
+			if (n / i < (int)prec.size()) {
+				res[t] = prec[n / i];
+			} else {
+				res[t] = calc_queries(i, row_size[i], answers, ptr) + prec[primes[row_size[i] - 1]] - 1;
 			}
-			sort(all(qrs), [&](const Query& a, const Query& b) {
-				return a.id < b.id;
-			});
 		}
-		return calc_queries(i, (int)dp[i].size(), qrs) + prec[primes[(int)dp[i].size() - 1]] - 1;
+		return res;
+	}
+
+	// The answers for all the values of [n/k].
+	// For all of them filling the whole dp level by level is cheaper than answering the leaf queries.
+	QuotientArray<T> calc_all(int threads = 1) {
+		fill_dp(threads);
+		QuotientArray<T> res(n);
+		vector<li> is(res.large);
+		iota(all(is), 1);
+		const auto large = calc_many(is);
+		copy(all(large), res.begin());
+		for (int id = res.large; id < res.size(); ++id) {
+			res[id] = prec[res.value(id)];
+		}
+		return res;
 	}
 
 private:
+	// calc_queries walks the same tree in the same order, so the answers to the queries are consumed one by one
 	void fill_queries(li i, int j, vector<Query>& qrs) {
 		const li curn = n / i;
 		if (j == 0) {
 			return;
 		} else if (curn < K) {
-			int sz = qrs.size();
-			qrs.push_back({sz, (int)curn, j, 0ll});
-			return;
-		} else if (j >= (int)dp[i].size()) {
-			fill_queries(i, (int)dp[i].size() - 1, qrs);
-		} else if (dp[i][j] != def) {
+			qrs.push_back({(int)curn, j});
+		} else if (j >= row_size[i]) {
+			fill_queries(i, row_size[i] - 1, qrs);
+		} else if (computed[cell(i, j)] || pending[cell(i, j)]) {
 			return;
 		} else {
-			fill_queries(i * primes[j - 1], j - 1, qrs);
+			pending[cell(i, j)] = true;
 			fill_queries(i, j - 1, qrs);
+			fill_queries(i * primes[j - 1], j - 1, qrs);
+		}
+	}
+
+	// Answers all the queries by one sweep over the numbers in decreasing order of their least prime
+	vector<T> answer_queries(const vector<Query>& qrs) {
+		vector<T> res(qrs.size());
+		if (qrs.empty()) {
+			return res;
+		}
+		// counting sort by decreasing k
+		const int mx_k = max_element(all(qrs), [](const Query& a, const Query& b) { return a.k < b.k; })->k;
+		vector<int> start(mx_k + 2), order(qrs.size());
+		for (const auto& q : qrs) {
+			++start[mx_k - q.k + 1];
+		}
+		partial_sum(all(start), start.begin());
+		for (int t = 0; t < (int)qrs.size(); ++t) {
+			order[start[mx_k - qrs[t].k]++] = t;
+		}
+		Fenwick<T> f(K);
+		f.add(1, 1);
+		int idx = 0;
+		for (int k : sorted_numbers) {
+			if (idx >= (int)order.size()) {
+				break;
+			}
+			while (idx < (int)order.size() && erat[k] < primes[qrs[order[idx]].k]) {
+				res[order[idx]] = f.get(qrs[order[idx]].n);
+				++idx;
+			}
+			f.add(k, h_small[k]);
 		}
+		while (idx < (int)order.size()) {
+			res[order[idx]] = f.get(qrs[order[idx]].n);
+			++idx;
+		}
+		return res;
 	}
 
-	T calc_queries(li i, int j, vector<Query>& qrs) {
+	T calc_queries(li i, int j, const vector<T>& answers, int& ptr) {
 		const li curn = n / i;
 		if (j == 0) {
 			return hp(curn);
 		} else if (curn < K) {
-			T ans = qrs.back().ans;
-			qrs.pop_back();
-			return ans;
-		} else if (j >= (int)dp[i].size()) {
-			return calc_queries(i, (int)dp[i].size() - 1, qrs) + prec[primes[(int)dp[i].size() - 1] - 1] - prec[primes[j] - 1];
-		} else if (dp[i][j] != def) {
-			return dp[i][j];
+			return answers[ptr++];
+		} else if (j >= row_size[i]) {
+			return calc_queries(i, row_size[i] - 1, answers, ptr) + prec[primes[row_size[i] - 1] - 1] - prec[primes[j] - 1];
+		} else if (const li c = cell(i, j); !pending[c]) {
+			return cells[c];
 		} else {
+			pending[c] = false;
 			T ans = 0;
-			ans += calc_queries(i, j - 1, qrs);
-			ans -= calc_queries(i * primes[j - 1], j - 1, qrs) * h(primes[j - 1]);
-			return dp[i][j] = ans;
+			ans += calc_queries(i, j - 1, answers, ptr);
+			ans -= calc_queries(i * primes[j - 1], j - 1, answers, ptr) * h(primes[j - 1]);
+			computed[c] = true;
+			return cells[c] = ans;
 		}
 	}
 };
@@ -207,3 +314,66 @@ using PrimeCount = PrimePrefix<li, PowerClass<li, 0>, PowerClass<li, 1>>;
 
 template <typename T>
 using PrimeSum = PrimePrefix<T, PowerClass<T, 1>, RisingClass<T, 2>>;
+
+// Let f be a multiplicative function, such that on primes it is a linear combination of completely multiplicative functions h_t
+// (each component is given by a PrimePrefix for h_t and its coefficient); f_pe(p, e, p^e) = f(p^e).
+// Then this class allows one to calculate sum_{i=1}^{[n/k]} f(i) for every k in O(n^{3/4} / log n).
+// For example, for phi: f_pe = p^e - p^{e - 1}, components are PrimeSum with coefficient 1 and PrimeCount with coefficient -1.
+template <typename T, typename FuncPe>
+class MultiplicativePrefix {
+public:
+	const li n;
+	const int sq;
+	const FuncPe f_pe;
+
+	vector<int> primes;
+	vector<T> g_small;
+	QuotientArray<T> s;
+
+	explicit MultiplicativePrefix(li _n, FuncPe&& _f_pe = FuncPe()): n(_n), sq(isqrt(_n)), f_pe(_f_pe), s(_n, 0) {
+		primes = sieve(sq).second;
+		g_small.assign(sq + 1, 0);
+	}
+
+	// Adds coef * h to f on primes, pp must be built for the same n
+	template <typename U, typename FuncH, typename FuncHp>
+	void add_component(PrimePrefix<U, FuncH, FuncHp>& pp, const T& coef) {
+		assert(pp.n == n);
+		assert(!filled);
+		const auto values = pp.calc_all();
+		for (int id = 0; id < s.size(); ++id) {
+			s[id] += coef * T(values[id]);
+		}
+		for (int v = 1; v <= sq; ++v) {
+			g_small[v] += coef * T(values.at(v));
+		}
+	}
+
+	// Must be called after all the components are added
+	void fill() {
+		filled = true;
+		for (int idx = (int)primes.size() - 1; idx >= 0; --idx) {
+			const li p = primes[idx];
+			const T gp = g_small[p];
+			// ids go in decreasing order of values, so every s(v / p^e) still lacks numbers with the least prime p
+			for (int id = 0; id < s.size() && s.value(id) >= p * p; ++id) {
+				const li v = s.value(id);
+				T& cur = s[id];
+				for (li pe = p, e = 1; pe * p <= v; pe *= p, ++e) {
+					cur += f_pe(p, e, pe) * (s.at(v / pe) - gp) + f_pe(p, e + 1, pe * p);
+				}
+			}
+		}
+	}
+
+	// sum_{x=1}^{[n/i]} f(x)
+	T calc(li i) {
+		if (!filled) {
+			fill();
+		}
+		return s.at(n / i) + 1;
+	}
+
+private:
+	bool filled = false;
+};
@@ -1,13 +1,91 @@
 #pragma once
 
 #include "../base/util.h"
+#include "../base/parallel.h"
 
+#include <utility>
 #include <vector>
 
-using std::vector;
+using std::vector, std::pair;
 
-// __attribute__((target("avx2"), optimize("O3", "unroll-loops")))
-long long prime_count(const long long N) {
+// The kernels below are compiled for avx2 and for the default target, the version is picked once at runtime.
+
+inline bool prime_count_has_avx2() {
+	static const bool res = __builtin_cpu_supports("avx2");
+	return res;
+}
+
+// Removes multiples of p from the rough numbers roughs[from..to) and writes the survivors with their updated larges
+// to out_roughs/out_larges starting from position from; returns the number of survivors.
+// Writing in place is fine as long as the larges of other chunks are not modified meanwhile.
+__attribute__((always_inline))
+inline int prime_count_sift_roughs_impl(const long long N, const int v, const int p, const int pc, const int from, const int to,
+		const int* roughs, const long long* larges, const int* smalls, const vector<bool>& skip, int* out_roughs, long long* out_larges) {
+	int ns = from;
+	for (int k = from; k < to; ++k) {
+		int i = roughs[k];
+		if (skip[i]) continue;
+		long long d = (long long)i * p;
+		out_larges[ns] = larges[k] - (d <= v ? larges[smalls[d >> 1] - pc] : smalls[((int)(double(N) / d) - 1) >> 1]) + pc;
+		out_roughs[ns++] = i;
+	}
+	return ns - from;
+}
+
+__attribute__((target("avx2")))
+int prime_count_sift_roughs_avx2(const long long N, const int v, const int p, const int pc, const int from, const int to,
+		const int* roughs, const long long* larges, const int* smalls, const vector<bool>& skip, int* out_roughs, long long* out_larges) {
+	return prime_count_sift_roughs_impl(N, v, p, pc, from, to, roughs, larges, smalls, skip, out_roughs, out_larges);
+}
+
+int prime_count_sift_roughs(const long long N, const int v, const int p, const int pc, const int from, const int to,
+		const int* roughs, const long long* larges, const int* smalls, const vector<bool>& skip, int* out_roughs, long long* out_larges) {
+	if (prime_count_has_avx2()) {
+		return prime_count_sift_roughs_avx2(N, v, p, pc, from, to, roughs, larges, smalls, skip, out_roughs, out_larges);
+	}
+	return prime_count_sift_roughs_impl(N, v, p, pc, from, to, roughs, larges, smalls, skip, out_roughs, out_larges);
+}
+
+__attribute__((always_inline))
+inline void prime_count_update_smalls_impl(int* smalls, int from, int to, int c) {
+	for (int i = from; i < to; ++i) smalls[i] -= c;
+}
+
+__attribute__((target("avx2")))
+void prime_count_update_smalls_avx2(int* smalls, int from, int to, int c) {
+	prime_count_update_smalls_impl(smalls, from, to, c);
+}
+
+void prime_count_update_smalls(int* smalls, int from, int to, int c) {
+	if (prime_count_has_avx2()) {
+		prime_count_update_smalls_avx2(smalls, from, to, c);
+	} else {
+		prime_count_update_smalls_impl(smalls, from, to, c);
+	}
+}
+
+__attribute__((always_inline))
+inline long long prime_count_final_term_impl(const long long M, const int l, const int e, const int* roughs, const int* smalls) {
+	long long t = 0;
+	for (int k = l + 1; k <= e; ++k) t += smalls[((int)(double(M) / roughs[k]) - 1) >> 1];
+	return t;
+}
+
+__attribute__((target("avx2")))
+long long prime_count_final_term_avx2(const long long M, const int l, const int e, const int* roughs, const int* smalls) {
+	return prime_count_final_term_impl(M, l, e, roughs, smalls);
+}
+
+long long prime_count_final_term(const long long M, const int l, const int e, const int* roughs, const int* smalls) {
+	if (prime_count_has_avx2()) {
+		return prime_count_final_term_avx2(M, l, e, roughs, smalls);
+	}
+	return prime_count_final_term_impl(M, l, e, roughs, smalls);
+}
+
+// Lucy_Hedgehog-like prime counting in O(N^{3/4} / log N) time and O(sqrt(N)) memory.
+// The sifting of rough numbers and the final sum are split over `threads` threads.
+long long prime_count(const long long N, int threads = 1) {
 	if (N <= 1) return 0;
 	if (N == 2) return 1;
 	const int v = isqrt(N);
@@ -15,40 +93,70 @@ long long prime_count(const long long N) {
 	vector<int> smalls(s); for (int i = 1; i < s; ++i) smalls[i] = i;
 	vector<int> roughs(s); for (int i = 0; i < s; ++i) roughs[i] = 2 * i + 1;
 	vector<long long> larges(s); for (int i = 0; i < s; ++i) larges[i] = (N / (2 * i + 1) - 1) / 2;
+	vector<int> new_roughs(threads > 1 ? s : 0);
+	vector<long long> new_larges(threads > 1 ? s : 0);
 	vector<bool> skip(v + 1);
-	const auto divide = [] (long long n, long long d) -> int { return double(n) / d; };
+	vector<int> from(threads + 1), cnt(threads);
+	vector<pair<int, int>> ranges;
+	vector<int> cs;
 	const auto half = [] (int n) -> int { return (n - 1) >> 1; };
+	// chunks smaller than this are not worth a thread
+	constexpr int min_chunk = 1 << 14;
 	int pc = 0;
 	for (int p = 3; p <= v; p += 2) if (!skip[p]) {
 		int q = p * p;
 		if ((long long)q * q > N) break;
 		skip[p] = true;
 		for (int i = q; i <= v; i += 2 * p) skip[i] = true;
-		int ns = 0;
-		for (int k = 0; k < s; ++k) {
-			int i = roughs[k];
-			if (skip[i]) continue;
-			long long d = (long long)i * p;
-			larges[ns] = larges[k] - (d <= v ? larges[smalls[d >> 1] - pc] : smalls[half(divide(N, d))]) + pc;
-			roughs[ns++] = i;
+		const int th = max(1, min(threads, s / min_chunk));
+		if (th == 1) {
+			s = prime_count_sift_roughs(N, v, p, pc, 0, s, roughs.data(), larges.data(), smalls.data(), skip, roughs.data(), larges.data());
+		} else {
+			// other threads read larges of the whole array, so the survivors go to separate buffers
+			for (int t = 0; t <= th; ++t) from[t] = (long long)s * t / th;
+			run_threads(th, [&](int t) {
+				cnt[t] = prime_count_sift_roughs(N, v, p, pc, from[t], from[t + 1], roughs.data(), larges.data(), smalls.data(), skip,
+						new_roughs.data(), new_larges.data());
+			});
+			s = 0;
+			for (int t = 0; t < th; ++t) {
+				copy_n(new_roughs.begin() + from[t], cnt[t], roughs.begin() + s);
+				copy_n(new_larges.begin() + from[t], cnt[t], larges.begin() + s);
+				s += cnt[t];
+			}
 		}
-		s = ns;
+		// all the subtracted values are read before any of the (disjoint) ranges is modified
+		ranges.clear();
+		cs.clear();
 		for (int i = half(v), j = ((v / p) - 1) | 1; j >= p; j -= 2) {
-			int c = smalls[j >> 1] - pc;
-			for (int e = (j * p) >> 1; i >= e; --i) smalls[i] -= c;
+			int e = (j * p) >> 1;
+			if (i < e) continue;
+			ranges.push_back({e, i + 1}), cs.push_back(smalls[j >> 1] - pc);
+			i = e - 1;
 		}
+		parallel_for(0, ranges.size(), [&](long long r, int) {
+			prime_count_update_smalls(smalls.data(), ranges[r].first, ranges[r].second, cs[r]);
+		}, max(1, min(threads, half(v) / min_chunk)), 64);
 		++pc;
 	}
 	larges[0] += (long long)(s + 2 * (pc - 1)) * (s - 1) / 2;
 	for (int k = 1; k < s; ++k) larges[0] -= larges[k];
-	for (int l = 1; l < s; ++l) {
+	// the terms are nonzero exactly for l < last
+	const auto nonzero = [&](int l) {
+		long long M = N / roughs[l];
+		return smalls[half(M / roughs[l])] - pc >= l + 1;
+	};
+	int last = 1;
+	for (int step = 1 << 30; step; step >>= 1) {
+		if (last - 1 + step < s && nonzero(last - 1 + step)) last += step;
+	}
+	vector<long long> partial(threads);
+	parallel_for(1, last, [&](long long l, int t) {
 		int q = roughs[l];
 		long long M = N / q;
 		int e = smalls[half(M / q)] - pc;
-		if (e < l + 1) break;
-		long long t = 0;
-		for (int k = l + 1; k <= e; ++k) t += smalls[half(divide(M, roughs[k]))];
-		larges[0] += t - (long long)(e - l) * (pc + l - 1);
-	}
+		partial[t] += prime_count_final_term(M, l, e, roughs.data(), smalls.data()) - (long long)(e - l) * (pc + l - 1);
+	}, threads, 256);
+	for (auto x : partial) larges[0] += x;
 	return larges[0] + 1;
 }
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "../base/defines.h"
+#include "../base/util.h"
+#include "../base/parallel.h"
+#include "../ds/fenwick.h"
+#include "segmented_sieve.h"
+#include "sieve.h"
+
+using std::vector, std::min, std::max;
+
+// Deleglise-Rivat prime counting: pi(x) = phi(x, a) + a - 1 - P2(x, a), a = pi(y), y = alpha * x^{1/3}.
+// phi(x, a) is split into ordinary leaves (S1, over squarefree m <= y), easy special leaves (their phi values
+// follow from a pi table up to y) and hard special leaves, which are counted while sieving [1, x / y] segment by segment
+// with a Fenwick tree over the words of the bit-sieve. P2 is computed with the segmented sieve.
+// Memory is O(y + sqrt(x / y)), the hard leaves can be processed by several threads.
+class DelegliseRivat {
+public:
+	using u64 = uint64_t;
+
+	const li x;
+	li y, z;
+	int a, c;
+
+	explicit DelegliseRivat(li _x, int _threads = 1): x(_x), threads(_threads) {}
+
+	li calc() {
+		if (x < 100000) {
+			return SegmentedSieve(x).count_primes(0, x + 1);
+		}
+		const double lg = log(x);
+		const double alpha = max(1., min(lg * lg * lg / 2500, 20.));
+		y = max<li>(icbrt(x) * alpha, icbrt(x) + 1);
+		y = min<li>(y, isqrt(x) - 1);
+		z = x / y;
+		tie(lpf, primes) = sieve(y);
+		{
+			const auto mu_int = calc_mu(lpf);
+			mu.assign(mu_int.begin(), mu_int.end());
+		}
+		lpf[1] = INT32_MAX;
+		pi.assign(y + 1, 0);
+		for (int p : primes) {
+			pi[p] = 1;
+		}
+		for (int i = 1; i <= y; ++i) {
+			pi[i] += pi[i - 1];
+		}
+		a = pi[y];
+		primes.insert(primes.begin(), 0);	// 1-indexed from now on
+		c = min(a, 6);
+		return s1() + s2_easy() + s2_hard() + a - 1 - p2();
+	}
+
+private:
+	const int threads;
+	vector<int> lpf, primes, pi;
+	vector<int8_t> mu;
+
+	li s1() const {
+		int pp = 1;
+		for (int i = 1; i <= c; ++i) {
+			pp *= primes[i];
+		}
+		vector<int> table(pp + 1);
+		for (int i = 0; i < pp; ++i) {
+			bool ok = true;
+			for (int j = 1; j <= c; ++j) {
+				ok &= i % primes[j] != 0;
+			}
+			table[i + 1] = table[i] + ok;
+		}
+		// phi(t, c) is periodic modulo pp = p_1 * ... * p_c, table[t] = phi(t - 1, c) for t <= pp
+		li res = 0;
+		for (int m = 1; m <= y; ++m) {
+			if (mu[m] && lpf[m] > primes[c]) {
+				const li t = x / m;
+				res += mu[m] * (t / pp * table[pp] + table[t % pp + 1]);
+			}
+		}
+		return res;
+	}
+
+	// the largest m such that the leaf x / (p_b m) is hard, i.e. does not fit into the pi table
+	// or is not smaller than p_b^2
+	li hard_max(int b) const {
+		const li lim = min<li>(y, sqr(primes[b]) - 1);
+		return x / primes[b] / (lim + 1);
+	}
+
+	// For p_b > sqrt(y) the leaves are x / (p_b q) for primes q > p_b. Those with x / (p_b q) < p_b are trivial (phi = 1),
+	// the rest are grouped into clusters of consecutive q sharing the same pi(x / (p_b q)).
+	li s2_easy() const {
+		li res = 0;
+		for (int b = c + 1; b < a; ++b) {
+			const li p = primes[b];
+			const li from = max(y / p, hard_max(b));	// easy leaves have m > from
+			if (p * p <= y) {
+				for (li m = from + 1; m <= y; ++m) {
+					if (mu[m] && lpf[m] > p) {
+						const li xn = x / (p * m);
+						res -= mu[m] * (xn < p ? 1 : pi[xn] - b + 2);
+					}
+				}
+				continue;
+			}
+			const li lo = max(from, p);
+			if (lo >= y) {
+				continue;
+			}
+			const li trivial = max(lo, x / p / p);
+			if (trivial < y) {
+				res += pi[y] - pi[trivial];
+			}
+			const li hi = min(trivial, y);
+			for (int i = pi[lo] + 1; i <= pi[hi];) {
+				const int l = pi[x / (p * primes[i])];
+				const int j = pi[min(hi, x / (p * primes[l]))];
+				res += (li)(j - i + 1) * (l - b + 2);
+				i = j + 1;
+			}
+		}
+		return res;
+	}
+
+	// Hard leaves of segments [from, to); phi[b] counts the numbers of the chunk left after sieving by the first b - 1 primes,
+	// mu_sum[b] is the sum of -mu(m) over the leaves, whose phi values lack the counts of the previous chunks.
+	struct Chunk {
+		li s2 = 0;
+		vector<li> phi, mu_sum;
+	};
+
+	Chunk s2_chunk(li from, li to, int seg) const {
+		Chunk res;
+		const int words = seg / 64;
+		vector<u64> bits(words);
+		Fenwick<int> f(words);
+		vector<li> next(a + 1, 0);
+		for (li low = from; low < to; low += seg) {
+			const li high = min(low + seg, to);
+			fill(bits.begin(), bits.end(), ~0ull);
+			if (high - low < seg) {
+				const int len = high - low;
+				fill(bits.begin() + (len + 63) / 64, bits.end(), 0);
+				if (len & 63) {
+					bits[len / 64] = (1ull << (len & 63)) - 1;
+				}
+			}
+			if (low == 0) {
+				bits[0] &= ~1ull;	// 0 is not counted
+			}
+			for (int b = 1; b <= c; ++b) {
+				const li p = primes[b];
+				for (li k = (low + p - 1) / p * p; k < high; k += p) {
+					bits[(k - low) >> 6] &= ~(1ull << ((k - low) & 63));
+				}
+			}
+			fill(f.a.begin(), f.a.end(), 0);
+			for (int w = 0; w < words; ++w) {
+				f.add(w, __builtin_popcountll(bits[w]));
+			}
+			const auto count = [&](li t) -> li {	// unsieved numbers in [low, t]
+				const li i = t - low;
+				return f.get((i >> 6) - 1) + __builtin_popcountll(bits[i >> 6] & (~0ull >> (63 - (i & 63))));
+			};
+			for (int b = c + 1; b < a; ++b) {
+				const li p = primes[b];
+				const li min_m = max(x / (p * high), y / p);
+				const li max_m = min({low ? x / (p * low) : y, y, hard_max(b)});
+				if (p >= max_m) {
+					break;
+				}
+				if ((int)res.phi.size() <= b) {
+					res.phi.resize(b + 1, 0);
+					res.mu_sum.resize(b + 1, 0);
+				}
+				if (p * p <= y) {
+					for (li m = max_m; m > min_m; --m) {
+						if (mu[m] && lpf[m] > p) {
+							const li xn = x / (p * m);
+							res.s2 -= mu[m] * (res.phi[b] + count(xn));
+							res.mu_sum[b] -= mu[m];
+						}
+					}
+				} else {
+					// m has to be a prime larger than p
+					for (int i = pi[max_m]; i > max(pi[min(min_m, y)], b); --i) {
+						const li xn = x / (p * primes[i]);
+						res.s2 += res.phi[b] + count(xn);
+						++res.mu_sum[b];
+					}
+				}
+				res.phi[b] += count(high - 1);
+				if (!next[b]) {
+					next[b] = max(p, (low + p - 1) / p * p);
+				}
+				li k = next[b];
+				for (; k < high; k += p) {
+					const li i = k - low;
+					if (bits[i >> 6] >> (i & 63) & 1) {
+						bits[i >> 6] &= ~(1ull << (i & 63));
+						f.add(i >> 6, -1);
+					}
+				}
+				next[b] = k;
+			}
+		}
+		return res;
+	}
+
+	li s2_hard() const {
+		const li len = z + 1;
+		int seg = 1 << 16;
+		while ((li)seg * seg < len && seg < (1 << 22)) {
+			seg *= 2;
+		}
+		const li segments = (len + seg - 1) / seg;
+		const int chunks = min<li>(threads, segments);
+		vector<Chunk> res(chunks);
+		// chunk boundaries are spread so that every chunk sieves about the same count of numbers
+		vector<li> bounds(chunks + 1);
+		for (int i = 0; i <= chunks; ++i) {
+			bounds[i] = min(len, segments * i / chunks * seg);
+		}
+		run_threads(chunks, [&](int i) {
+			res[i] = s2_chunk(bounds[i], bounds[i + 1], seg);
+		});
+		li s2 = 0;
+		vector<li> phi(a + 1, 0);
+		for (const auto& ch : res) {
+			s2 += ch.s2;
+			for (int b = 0; b < (int)ch.mu_sum.size(); ++b) {
+				s2 += ch.mu_sum[b] * phi[b];
+				phi[b] += ch.phi[b];
+			}
+		}
+		return s2;
+	}
+
+	// P2(x, a) = sum over primes y < p <= sqrt(x) of pi(x / p) - pi(p) + 1
+	li p2() const {
+		const li sq = isqrt(x);
+		if (sq <= y) {
+			return 0;
+		}
+		SegmentedSieve ss(z);
+		li res = 0;
+		// primes of (y, sq] are generated in decreasing order block by block
+		vector<li> ps;
+		li p_hi = sq + 1;
+		vector<u64> pbits(ss.block / 64);
+		const auto next_prime = [&]() -> li {
+			while (ps.empty()) {
+				if (p_hi <= y + 1) {
+					return -1;
+				}
+				const li lo = max(y + 1, p_hi - ss.block);
+				ss.sieve_block(lo, p_hi, pbits.data());
+				SegmentedSieve::for_each_set_bit(lo, p_hi, pbits.data(), [&](li p) {
+					ps.push_back(p);
+				});
+				p_hi = lo;
+			}
+			li p = ps.back();
+			ps.pop_back();
+			return p;
+		};
+		li cnt = a + ss.count_primes(y + 1, sq);	// pi(lo - 1) for the current block
+		li k = cnt + ss.count_primes(sq, sq + 1);	// pi(p) for the current prime
+		li p = next_prime();
+		ss.for_each_block(sq, z + 1, [&](li lo, li hi, const u64* bits) {
+			li w = 0, full = 0;	// full = primes among the first w words of the block
+			while (p != -1 && x / p < hi) {
+				const li t = x / p;
+				const li i = (t - 1) / 2 - lo / 2 + 1;	// bits [0, i) correspond to the odd numbers <= t
+				for (; w < i / 64; ++w) {
+					full += __builtin_popcountll(bits[w]);
+				}
+				const li before = full + ((i & 63) ? __builtin_popcountll(bits[w] & ((1ull << (i & 63)) - 1)) : 0);
+				res += cnt + before - k + 1;
+				--k;
+				p = next_prime();
+			}
+			cnt += SegmentedSieve::count_set_bits(lo, hi, bits);
+		});
+		return res;
+	}
+};
+
+li prime_count_dr(li x, int threads = 1) {
+	return DelegliseRivat(x, threads).calc();
+}
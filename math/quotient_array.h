@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+
+#include "../base/defines.h"
+#include "../base/util.h"
+#include "../base/parallel.h"
+
+using std::vector;
+
+// Stores a value for every distinct [n/k] in one contiguous array.
+// Ids go in decreasing order of the values: ids [0, n / (sq + 1)) correspond to [n/k] for k = id + 1,
+// the remaining ones correspond to v = sq, sq - 1, ..., 1, where sq = isqrt(n).
+template <typename T>
+class QuotientArray {
+public:
+	li n;
+	int sq;
+	int large;	// the number of values greater than sq
+
+	explicit QuotientArray(li _n = 1, const T& init = T()): n(_n), sq(isqrt(_n)), large(_n / (isqrt(_n) + 1)), data(large + sq, init) {}
+
+	int size() const {
+		return data.size();
+	}
+
+	li value(int id) const {
+		return id < large ? n / (id + 1) : large + sq - id;
+	}
+
+	// v must be of the form [n/k]
+	int index(li v) const {
+		return v <= sq ? large + sq - v : n / v - 1;
+	}
+
+	T& operator [](int id) {
+		return data[id];
+	}
+
+	const T& operator [](int id) const {
+		return data[id];
+	}
+
+	T& at(li v) {
+		return data[index(v)];
+	}
+
+	const T& at(li v) const {
+		return data[index(v)];
+	}
+
+	// Calls f(id, value, element) for every id, possibly from several threads
+	template <typename Func>
+	void for_each(const Func& f, int threads = 1) {
+		parallel_for(0, size(), [&](long long id, int) {
+			f((int)id, value(id), data[id]);
+		}, threads, 1 << 10);
+	}
+
+	auto begin() { return data.begin(); }
+	auto end() { return data.end(); }
+	auto begin() const { return data.begin(); }
+	auto end() const { return data.end(); }
+
+private:
+	vector<T> data;
+};
@@ -0,0 +1,459 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <numeric>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "../base/defines.h"
+#include "../base/parallel.h"
+#include "../base/util.h"
+#include "sieve.h"
+
+using std::vector, std::min, std::max;
+using std::mutex, std::unique_lock, std::condition_variable;
+using std::tuple, std::apply, std::declval;
+
+// Per-block storage for several multiplicative functions given by their f_pe
+template <typename... FuncPe>
+struct MultiplicativeBuffers {
+	tuple<vector<decltype(declval<FuncPe>()(2ll, 1, 2ll))>...> vals;
+	vector<li> rest;	// the part of a number not yet divided out
+
+	explicit MultiplicativeBuffers(int len): vals(vector<decltype(declval<FuncPe>()(2ll, 1, 2ll))>(len)...), rest(len) {}
+};
+
+// Sieve of Eratosthenes over [l, r) that walks the range in blocks of `block` odd numbers,
+// so the memory is O(sqrt(r) / log(r) + block) instead of O(r).
+// Only odd numbers are stored, one bit per number; multiples of 3, 5, 7 and 11 are removed
+// by copying a precomputed wheel pattern (period 2 * 3 * 5 * 7 * 11 = 2310), the rest is crossed off.
+class SegmentedSieve {
+public:
+	using u64 = uint64_t;
+
+	static constexpr int wheel_period = 3 * 5 * 7 * 11;
+
+	const li n;
+	const int block;
+	vector<int> primes;	// all primes up to sqrt(n)
+
+	explicit SegmentedSieve(li _n, int _block = 1 << 18): n(_n), block((_block + 63) / 64 * 64) {
+		primes = sieve(max(isqrt(n), 2)).second;
+		wheel.assign(wheel_period + 1, 0);
+		for (int i = 0; i < wheel_period * 64; ++i) {
+			const int x = (2 * i + 1) % wheel_period;
+			if (x % 3 && x % 5 && x % 7 && x % 11) {
+				wheel[i >> 6] |= 1ull << (i & 63);
+			}
+		}
+		wheel[wheel_period] = wheel[0];
+	}
+
+	// Calls f(lo, hi, bits) for consecutive blocks covering [l, r); bit i of bits is set iff 2 * (lo / 2 + i) + 1 is prime.
+	// The number 2 is never reported by this function.
+	template <typename Func>
+	void for_each_block(li l, li r, Func&& f) const {
+		vector<u64> bits(block / 64);
+		for (li lo = l; lo < r; lo = next_block_start(lo)) {
+			const li hi = min(r, next_block_start(lo));
+			sieve_block(lo, hi, bits.data());
+			f(lo, hi, (const u64*)bits.data());
+		}
+	}
+
+	// Calls f(p) for every prime l <= p < r in increasing order.
+	template <typename Func>
+	void for_each_prime(li l, li r, Func&& f) const {
+		if (l <= 2 && 2 < r) {
+			f(2ll);
+		}
+		for_each_block(l, r, [&](li lo, li hi, const u64* bits) {
+			for_each_set_bit(lo, hi, bits, f);
+		});
+	}
+
+	li count_primes(li l, li r) const {
+		li res = (l <= 2 && 2 < r);
+		for_each_block(l, r, [&](li lo, li hi, const u64* bits) {
+			res += count_set_bits(lo, hi, bits);
+		});
+		return res;
+	}
+
+	class Iterator {
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = li;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const li*;
+		using reference = const li&;
+
+		Iterator(): owner(nullptr), cur(-1) {}
+
+		Iterator(const SegmentedSieve* _owner, li l, li _r): owner(_owner), r(_r), lo(l), hi(l), bits(_owner->block / 64), pos(0), cur(-1) {
+			if (l <= 2 && 2 < r) {
+				cur = 2;
+			} else {
+				advance();
+			}
+		}
+
+		li operator *() const {
+			return cur;
+		}
+
+		Iterator& operator ++() {
+			advance();
+			return *this;
+		}
+
+		bool operator ==(const Iterator& ot) const {
+			return cur == ot.cur;
+		}
+
+		bool operator !=(const Iterator& ot) const {
+			return cur != ot.cur;
+		}
+
+	private:
+		const SegmentedSieve* owner;
+		li r, lo, hi;
+		vector<u64> bits;
+		int pos;	// next bit to look at in the current block
+		li cur;
+
+		void advance() {
+			while (true) {
+				const int len = (int)(hi / 2 - lo / 2);
+				while (pos < len && !(bits[pos >> 6] >> (pos & 63))) {
+					pos = (pos | 63) + 1;
+				}
+				if (pos < len) {
+					pos += __builtin_ctzll(bits[pos >> 6] >> (pos & 63));
+					if (pos < len) {
+						cur = 2 * (lo / 2 + pos) + 1;
+						++pos;
+						return;
+					}
+				}
+				if (hi >= r) {
+					cur = -1;
+					return;
+				}
+				lo = hi;
+				hi = min(r, owner->next_block_start(lo));
+				owner->sieve_block(lo, hi, bits.data());
+				pos = 0;
+			}
+		}
+	};
+
+	struct Range {
+		const SegmentedSieve* owner;
+		li l, r;
+
+		Iterator begin() const {
+			return Iterator(owner, l, r);
+		}
+
+		Iterator end() const {
+			return Iterator();
+		}
+	};
+
+	// for (li p : ss.range(l, r)) iterates over primes in [l, r)
+	Range range(li l, li r) const {
+		return {this, l, r};
+	}
+
+	// Calls f(lo, hi, spf) for consecutive blocks covering [l, r); spf[x - lo] is the smallest prime factor of x
+	// if x is composite and 0 if x is prime or x < 2.
+	template <typename Func>
+	void for_each_spf_block(li l, li r, Func&& f) const {
+		vector<uint32_t> spf(2 * block);
+		for (li lo = l; lo < r; lo += 2 * block) {
+			const li hi = min(r, lo + 2 * block);
+			fill_n(spf.begin(), hi - lo, 0);
+			for (int p : primes) {
+				if (sqr(p) >= hi) {
+					break;
+				}
+				for (li m = max(sqr(p), (lo + p - 1) / p * p); m < hi; m += p) {
+					if (!spf[m - lo]) {
+						spf[m - lo] = p;
+					}
+				}
+			}
+			f(lo, hi, (const uint32_t*)spf.data());
+		}
+	}
+
+	// Calls f(lo, hi, vals) for consecutive blocks covering [l, r), vals[x - lo] = g(x) for x >= 1,
+	// where g is the multiplicative function given by f_pe(p, e, p^e) = g(p^e).
+	template <typename T, typename FuncPe, typename Func>
+	void for_each_multiplicative_block(li l, li r, const FuncPe& f_pe, Func&& f) const {
+		for_each_multiplicative_blocks(l, r, [&](li lo, li hi, const auto* vals) {
+			f(lo, hi, (const T*)vals);
+		}, [&](li p, int e, li pe) { return T(f_pe(p, e, pe)); });
+	}
+
+	// The same for several functions at once, f(lo, hi, vals_1, ..., vals_k) gets the values of the t-th function in vals_t
+	template <typename Func, typename... FuncPe>
+	void for_each_multiplicative_blocks(li l, li r, Func&& f, const FuncPe&... f_pe) const {
+		MultiplicativeBuffers<FuncPe...> buf(2 * block);
+		for (li lo = max(l, 1ll); lo < r; lo += 2 * block) {
+			const li hi = min(r, lo + 2 * block);
+			multiplicative_block(lo, hi, buf, f_pe...);
+			apply([&](const auto&... vals) { f(lo, hi, vals.data()...); }, buf.vals);
+		}
+	}
+
+	// Values of the functions at [lo, hi), hi - lo <= 2 * block, are put into buf.vals
+	template <typename... FuncPe>
+	void multiplicative_block(li lo, li hi, MultiplicativeBuffers<FuncPe...>& buf, const FuncPe&... f_pe) const {
+		const int len = hi - lo;
+		const auto fs = tie(f_pe...);
+		// calls g(values, f_pe) for every function
+		const auto for_all = [&](const auto& g) {
+			[&]<size_t... I>(index_sequence<I...>) {
+				(g(get<I>(buf.vals), get<I>(fs)), ...);
+			}(index_sequence_for<FuncPe...>{});
+		};
+		for_all([&](auto& vals, const auto&) { fill_n(vals.begin(), len, 1); });
+		auto& rest = buf.rest;
+		iota(rest.begin(), rest.begin() + len, lo);
+		for (int p : primes) {
+			if (sqr(p) >= hi) {
+				break;
+			}
+			for (li m = (lo + p - 1) / p * p; m < hi; m += p) {
+				li& x = rest[m - lo];
+				int e = 0;
+				li pe = 1;
+				do {
+					x /= p;
+					pe *= p;
+					++e;
+				} while (x % p == 0);
+				for_all([&](auto& vals, const auto& f_pe) { vals[m - lo] *= f_pe(p, e, pe); });
+			}
+		}
+		for (int i = 0; i < len; ++i) {
+			if (rest[i] > 1) {
+				for_all([&](auto& vals, const auto& f_pe) { vals[i] *= f_pe(rest[i], 1, rest[i]); });
+			}
+		}
+	}
+
+	// block-by-block counterparts of calc_phi and calc_mu from sieve.h
+	template <typename Func>
+	void for_each_phi_block(li l, li r, Func&& f) const {
+		for_each_multiplicative_block<li>(l, r, [](li p, int, li pe) { return pe / p * (p - 1); }, f);
+	}
+
+	template <typename Func>
+	void for_each_mu_block(li l, li r, Func&& f) const {
+		for_each_multiplicative_block<int>(l, r, [](li, int e, li) { return e > 1 ? 0 : -1; }, f);
+	}
+
+	template <typename Func>
+	static void for_each_set_bit(li lo, li hi, const u64* bits, Func&& f) {
+		const int len = (int)(hi / 2 - lo / 2);
+		const li base = lo / 2;
+		for (int w = 0; w * 64 < len; ++w) {
+			u64 cur = bits[w];
+			while (cur) {
+				const int i = w * 64 + __builtin_ctzll(cur);
+				cur &= cur - 1;
+				f(2 * (base + i) + 1);
+			}
+		}
+	}
+
+	static li count_set_bits(li lo, li hi, const u64* bits) {
+		const int len = (int)(hi / 2 - lo / 2);
+		li res = 0;
+		for (int w = 0; w * 64 < len; ++w) {
+			res += __builtin_popcountll(bits[w]);
+		}
+		return res;
+	}
+
+	// Sieves odd numbers of [lo, hi), which must not be longer than 2 * block, into bits.
+	// Bits past the end of the range are cleared.
+	void sieve_block(li lo, li hi, u64* bits) const {
+		const li lo_idx = lo / 2;
+		const li hi_idx = hi / 2;
+		const int len = hi_idx - lo_idx;
+		const int words = (len + 63) / 64;
+		{
+			const li s = lo_idx % (64ll * wheel_period);
+			const int shift = s & 63;
+			int wi = s >> 6;
+			for (int w = 0; w < words; ++w) {
+				bits[w] = shift ? (wheel[wi] >> shift) | (wheel[wi + 1] << (64 - shift)) : wheel[wi];
+				if (++wi == wheel_period) {
+					wi = 0;
+				}
+			}
+		}
+		if (len & 63) {
+			bits[words - 1] &= (1ull << (len & 63)) - 1;
+		}
+		if (lo_idx == 0 && len > 0) {
+			bits[0] &= ~1ull;	// 1 is not prime
+		}
+		for (int p : {3, 5, 7, 11}) {
+			if (lo_idx <= p / 2 && p / 2 < hi_idx) {
+				bits[(p / 2 - lo_idx) >> 6] |= 1ull << ((p / 2 - lo_idx) & 63);
+			}
+		}
+		for (int p : primes) {
+			if (p <= 11) {
+				continue;
+			}
+			if (sqr(p) >= hi) {
+				break;
+			}
+			li m = max(sqr(p), (lo + p - 1) / p * p);
+			if (!(m & 1)) {
+				m += p;
+			}
+			for (li i = m / 2 - lo_idx; i < len; i += p) {
+				bits[i >> 6] &= ~(1ull << (i & 63));
+			}
+		}
+	}
+
+	// blocks always start at multiples of 2 * block so that any block fits into the buffer
+	li next_block_start(li lo) const {
+		return (lo / (2ll * block) + 1) * (2ll * block);
+	}
+
+private:
+	vector<u64> wheel;
+};
+
+// SegmentedSieve whose blocks are distributed over `threads` workers: each worker takes the next
+// block from a shared atomic cursor, the primes up to sqrt(n) are shared read-only.
+class ParallelSegmentedSieve : public SegmentedSieve {
+public:
+	const int threads;
+
+	explicit ParallelSegmentedSieve(li _n, int _threads = default_threads(), int _block = 1 << 18): SegmentedSieve(_n, _block), threads(_threads) {}
+
+	// Calls f(lo, hi, bits, thread_id) for every block of [l, r) in no particular order.
+	template <typename Func>
+	void for_each_block(li l, li r, const Func& f) const {
+		if (l >= r) {
+			return;
+		}
+		const li first = next_block_start(l);
+		const li blocks = first >= r ? 1 : 1 + (r - first + 2ll * block - 1) / (2ll * block);
+		vector<vector<u64>> bits(threads, vector<u64>(block / 64));
+		parallel_for(0, blocks, [&](li k, int tid) {
+			const li lo = k ? first + (k - 1) * 2 * block : l;
+			const li hi = min(r, k ? lo + 2 * block : first);
+			sieve_block(lo, hi, bits[tid].data());
+			f(lo, hi, (const u64*)bits[tid].data(), tid);
+		}, threads);
+	}
+
+	// Calls f(lo, hi, vals_1, ..., vals_k, thread_id) for every block of [l, r) in no particular order,
+	// vals_t[x - lo] is the value of the t-th multiplicative function given by f_pe_t(p, e, p^e).
+	template <typename Func, typename... FuncPe>
+	void for_each_multiplicative_blocks(li l, li r, const Func& f, const FuncPe&... f_pe) const {
+		l = max(l, 1ll);
+		if (l >= r) {
+			return;
+		}
+		const li blocks = (r - l + 2ll * block - 1) / (2ll * block);
+		vector<MultiplicativeBuffers<FuncPe...>> buf(threads, MultiplicativeBuffers<FuncPe...>(2 * block));
+		parallel_for(0, blocks, [&](li k, int tid) {
+			const li lo = l + k * 2 * block;
+			const li hi = min(r, lo + 2 * block);
+			multiplicative_block(lo, hi, buf[tid], f_pe...);
+			apply([&](const auto&... vals) { f(lo, hi, vals.data()..., tid); }, buf[tid].vals);
+		}, threads);
+	}
+
+	// Calls f(p) for every prime l <= p < r in increasing order.
+	// Blocks are sieved in parallel, but f is never called concurrently.
+	template <typename Func>
+	void for_each_prime(li l, li r, Func&& f) const {
+		if (l <= 2 && 2 < r) {
+			f(2ll);
+		}
+		if (l >= r) {
+			return;
+		}
+		const li first = next_block_start(l);
+		const li blocks = first >= r ? 1 : 1 + (r - first + 2ll * block - 1) / (2ll * block);
+		vector<vector<u64>> bits(threads, vector<u64>(block / 64));
+		mutex mtx;
+		condition_variable cv;
+		li emitted = 0;
+		parallel_for(0, blocks, [&](li k, int tid) {
+			const li lo = k ? first + (k - 1) * 2 * block : l;
+			const li hi = min(r, k ? lo + 2 * block : first);
+			sieve_block(lo, hi, bits[tid].data());
+			unique_lock lock(mtx);
+			cv.wait(lock, [&]() { return emitted == k; });
+			for_each_set_bit(lo, hi, bits[tid].data(), f);
+			++emitted;
+			cv.notify_all();
+		}, threads);
+	}
+
+	// Computes seg(lo, hi, bits) for every block and folds the results with combine in the order of blocks.
+	template <typename T, typename SegFunc, typename Combine>
+	T reduce(li l, li r, T init, const SegFunc& seg, const Combine& combine) const {
+		if (l >= r) {
+			return init;
+		}
+		const li first = next_block_start(l);
+		const li blocks = first >= r ? 1 : 1 + (r - first + 2ll * block - 1) / (2ll * block);
+		vector<T> partial(blocks, init);
+		vector<vector<u64>> bits(threads, vector<u64>(block / 64));
+		parallel_for(0, blocks, [&](li k, int tid) {
+			const li lo = k ? first + (k - 1) * 2 * block : l;
+			const li hi = min(r, k ? lo + 2 * block : first);
+			sieve_block(lo, hi, bits[tid].data());
+			partial[k] = seg(lo, hi, (const u64*)bits[tid].data());
+		}, threads);
+		for (const auto& x : partial) {
+			init = combine(init, x);
+		}
+		return init;
+	}
+
+	li count_primes(li l, li r) const {
+		return (l <= 2 && 2 < r) + reduce(l, r, 0ll, count_set_bits, std::plus<li>());
+	}
+
+	// sum of h(p) over primes l <= p < r
+	template <typename T, typename FuncH>
+	T sum_h(li l, li r, const FuncH& h) const {
+		T res = reduce(l, r, T(0), [&](li lo, li hi, const u64* bits) {
+			T s = 0;
+			for_each_set_bit(lo, hi, bits, [&](li p) {
+				s += h(p);
+			});
+			return s;
+		}, std::plus<T>());
+		if (l <= 2 && 2 < r) {
+			res += h(2ll);
+		}
+		return res;
+	}
+
+	template <typename T>
+	T sum_primes(li l, li r) const {
+		return sum_h<T>(l, r, [](li p) { return T(p); });
+	}
+};
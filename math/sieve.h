@@ -1,9 +1,15 @@
 #pragma once
 
+#include <cstdint>
+#include <tuple>
 #include <vector>
 #include <utility>
 
+#include "../base/defines.h"
+#include "../base/traits.h"
+
 using std::vector, std::pair;
+using std::tuple, std::get, std::tie, std::index_sequence, std::index_sequence_for;
 
 pair<vector<int>, vector<int>> sieve(int n) {
 	vector<int> erat(n + 1);
@@ -46,3 +52,48 @@ vector<int> calc_mu(const vector<int>& erat) {
 	}
 	return mu;
 }
+
+// Computes several multiplicative functions on [0, n] in one pass of the linear sieve; the t-th function g_t is given by
+// f_pe_t(p, e, p^e) = g_t(p^e). Returns the tuple of the vectors of values, e.g. auto [phi, mu] = sieve_multiplicative(n, ...).
+template <typename... FuncPe>
+auto sieve_multiplicative(int n, const FuncPe&... f_pe) {
+	tuple<vector<decltype(f_pe(2ll, 1, 2ll))>...> res{vector<decltype(f_pe(2ll, 1, 2ll))>(n + 1)...};
+	const auto fs = tie(f_pe...);
+	// calls g(values, f_pe) for every function
+	const auto for_all = [&](const auto& g) {
+		[&]<size_t... I>(index_sequence<I...>) {
+			(g(get<I>(res), get<I>(fs)), ...);
+		}(index_sequence_for<FuncPe...>{});
+	};
+	if (n >= 1) {
+		for_all([&](auto& v, const auto&) { v[1] = 1; });
+	}
+	vector<int> lp(n + 1), primes;	// lp[i] is the least prime of i
+	for (int i = 2; i <= n; ++i) {
+		if (!lp[i]) {
+			lp[i] = i;
+			primes.push_back(i);
+			for_all([&](auto& v, const auto& f) { v[i] = f((li)i, 1, (li)i); });
+		}
+		for (int p : primes) {
+			if (p > lp[i] || 1ll * i * p > n) {
+				break;
+			}
+			const int ip = i * p;
+			lp[ip] = p;
+			if (p < lp[i]) {
+				for_all([&](auto& v, const auto&) { v[ip] = v[i] * v[p]; });
+			} else {
+				// ip = p^e * rest, this branch is taken for a small fraction of numbers
+				int rest = i / p, e = 2, pe = p * p;
+				while (rest % p == 0) {
+					rest /= p;
+					pe *= p;
+					++e;
+				}
+				for_all([&](auto& v, const auto& f) { v[ip] = v[rest] * f((li)p, e, (li)pe); });
+			}
+		}
+	}
+	return res;
+}
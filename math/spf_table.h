@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "../base/defines.h"
+#include "../base/parallel.h"
+#include "../base/util.h"
+#include "sieve.h"
+
+using std::vector, std::pair, std::min, std::max;
+using std::numeric_limits, std::tie;
+
+// Smallest prime factors of the numbers up to n in n / 2 entries of type Index:
+// only odd numbers are stored, the entry of a composite is 1 + the index of its smallest prime in primes, primes have 0.
+// The table is filled block by block, so every block is sieved in cache.
+template <typename Index = uint16_t>
+class SpfTable {
+public:
+	const li n;
+	vector<int> primes;	// odd primes up to sqrt(n)
+
+	explicit SpfTable(li _n, int threads = 1, int block = 1 << 16): n(_n) {
+		primes = sieve(max(isqrt(n), 2)).second;
+		primes.erase(primes.begin());
+		assert(primes.size() < (size_t)numeric_limits<Index>::max());
+		spf_idx.assign(n / 2 + 1, 0);
+		const li len = spf_idx.size();
+		parallel_for(0, (len + block - 1) / block, [&](li b, int) {
+			const li lo = b * block, hi = min(len, lo + block);	// entries [lo, hi), i.e. numbers 2 * lo + 1, ...
+			// larger primes go first, so the smallest one is written last
+			for (int k = (int)primes.size() - 1; k >= 0; --k) {
+				const li p = primes[k];
+				if (sqr(p) > 2 * hi - 1) {
+					continue;
+				}
+				li m = max(sqr(p), (2 * lo + 1 + p - 1) / p * p);
+				if (m % 2 == 0) {
+					m += p;
+				}
+				for (li i = m / 2; i < hi; i += p) {
+					spf_idx[i] = k + 1;
+				}
+			}
+		}, threads);
+	}
+
+	// x >= 2
+	li spf(li x) const {
+		if (x % 2 == 0) {
+			return 2;
+		}
+		const Index k = spf_idx[x / 2];
+		return k ? primes[k - 1] : x;
+	}
+
+	bool is_prime(li x) const {
+		return x == 2 || (x > 2 && x % 2 == 1 && !spf_idx[x / 2]);
+	}
+
+	struct End {};
+
+	// Iterates over pairs (p, e) of the factorization of x in increasing order of p
+	class FactorIterator {
+	public:
+		FactorIterator(const SpfTable* _t, li _x): t(_t), x(_x) {
+			advance();
+		}
+
+		pair<li, int> operator *() const {
+			return {p, e};
+		}
+
+		FactorIterator& operator ++() {
+			advance();
+			return *this;
+		}
+
+		bool operator !=(End) const {
+			return e > 0;
+		}
+
+	private:
+		const SpfTable* t;
+		li x, p = 0;
+		int e = 0;
+
+		void advance() {
+			e = 0;
+			if (x <= 1) {
+				return;
+			}
+			p = t->spf(x);
+			do {
+				x /= p;
+				++e;
+			} while (x % p == 0);
+		}
+	};
+
+	// Iterates over all divisors of x (not in sorted order) as a mixed-radix counter over the exponents
+	class DivisorIterator {
+	public:
+		DivisorIterator(const SpfTable* t, li x) {
+			for (FactorIterator it(t, x); it != End{}; ++it) {
+				tie(p[k], e[k]) = *it;
+				pe[k] = 1;
+				c[k] = 0;
+				++k;
+			}
+		}
+
+		li operator *() const {
+			return d;
+		}
+
+		DivisorIterator& operator ++() {
+			int i = 0;
+			while (i < k && c[i] == e[i]) {
+				d /= pe[i];
+				c[i] = 0;
+				pe[i] = 1;
+				++i;
+			}
+			if (i == k) {
+				done = true;
+			} else {
+				++c[i];
+				pe[i] *= p[i];
+				d *= p[i];
+			}
+			return *this;
+		}
+
+		bool operator !=(End) const {
+			return !done;
+		}
+
+	private:
+		// a number below 2^64 has at most 15 distinct prime factors
+		static constexpr int max_primes = 15;
+		li p[max_primes], pe[max_primes];
+		int e[max_primes], c[max_primes];
+		int k = 0;
+		li d = 1;
+		bool done = false;
+	};
+
+	template <typename Iterator>
+	struct Range {
+		const SpfTable* t;
+		li x;
+
+		Iterator begin() const {
+			return Iterator(t, x);
+		}
+
+		End end() const {
+			return {};
+		}
+	};
+
+	// for (auto [p, e] : spf.factorize(x))
+	Range<FactorIterator> factorize(li x) const {
+		return {this, x};
+	}
+
+	// for (li d : spf.divisors(x))
+	Range<DivisorIterator> divisors(li x) const {
+		return {this, x};
+	}
+
+private:
+	vector<Index> spf_idx;
+};
@@ -4,6 +4,8 @@
 #include <vector>
 #include <type_traits>
 
+#include "../math/quotient_array.h"
+
 using std::map, std::unordered_map, std::vector;
 using std::is_same_v, std::is_integral_v, std::decay_t;
 using std::forward, std::ref;
@@ -83,4 +85,32 @@ private:
 template <typename S, typename T, typename Container = map<S, T>, typename Fun = void>
 decltype(auto) Memoizer(Fun&& fun, size_t size = 1000000) {
 	return MemoizerResult<S, T, Container, decay_t<Fun>>(forward<Fun>(fun), size);
-}
\ No newline at end of file
+}
+
+// Memoizes f(self, v) for v of the form [n/k] in a QuotientArray
+template <typename T, typename Fun>
+class QuotientMemoizerResult {
+public:
+	template <typename F>
+	explicit QuotientMemoizerResult(li n, F&& _f): f(forward<F>(_f)), cache(n), calculated(cache.size(), false) {}
+
+	T operator ()(li x) {
+		const int id = cache.index(x);
+		if (calculated[id]) {
+			return cache[id];
+		}
+		auto res = f(ref(*this), x);
+		calculated[id] = true;
+		return cache[id] = res;
+	}
+
+private:
+	Fun f;
+	QuotientArray<T> cache;
+	vector<bool> calculated;
+};
+
+template <typename T, typename Fun = void>
+decltype(auto) QuotientMemoizer(li n, Fun&& fun) {
+	return QuotientMemoizerResult<T, decay_t<Fun>>(n, forward<Fun>(fun));
+}